@@ -0,0 +1,23 @@
+/*
+ * arena.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#ifndef INC_ARENA_H_
+#define INC_ARENA_H_
+
+#include "stdint.h"
+
+#define ARENA_BLOCK_SIZE 16 // bytes per block; slots are whole runs of blocks
+#define ARENA_BLOCKS 80 // blocks in the arena (1280 bytes)
+#define ARENA_MAX_BITS 128 // longest word stored in the arena; its slot also holds a sync bit and terminator
+
+char* arenaAlloc(uint16_t bytes);
+char* arenaResize(char* ptr, uint16_t bytes);
+void arenaFree(char* ptr);
+uint16_t arenaCapacity(const char* ptr);
+uint16_t arenaFreeBlocks(void);
+
+#endif /* INC_ARENA_H_ */
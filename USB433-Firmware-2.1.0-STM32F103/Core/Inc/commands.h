@@ -26,6 +26,7 @@
 #define TX_BUFFER_SIZE APP_RX_DATA_SIZE + 16
 extern char usb_tx_buffer[TX_BUFFER_SIZE];
 extern uint32_t last_USB_time;
+extern bool usb_stream_reports;
 extern const char version[];
 
 // rx/tx structs
@@ -53,16 +54,40 @@ typedef struct CommandNode {
 void processUSB(void);
 
 void pushUSB(void);
+uint16_t queueReport(uint8_t* buf, uint16_t len);
+void pushReport(void);
+void drainUSB(void);
+bool fillUsbTest(void);
+bool usbTestPending(void);
 
 // response functions
 void bufferOk(void);
 void bufferValueResponse(CommandContext* ctx, long responseValue);
+void bufferCode(uint8_t code);
+void bufferCodeText(uint8_t code, const char* text);
+void bufferCodeValue(uint8_t code, uint32_t value);
 
 // handler functions
 void handleLogic(CommandContext* ctx);
 void handleSyncBit(CommandContext* ctx);
 void handleStatus(CommandContext* ctx);
 void handleVersion(CommandContext* ctx);
+void handleLearn(CommandContext* ctx);
+void handleSleep(CommandContext* ctx);
+void handleSleepLatency(CommandContext* ctx);
+void handleTasks(CommandContext* ctx);
+void handlePerf(CommandContext* ctx);
+void handleIrqLatency(CommandContext* ctx);
+void handleIrqPriority(CommandContext* ctx);
+void handleCounters(CommandContext* ctx);
+void handleCountersBinary(CommandContext* ctx);
+void handleCountersStream(CommandContext* ctx);
+void handleTraceDump(CommandContext* ctx);
+void handleTraceClear(CommandContext* ctx);
+void handleTraceEnable(CommandContext* ctx);
+void handleUsbTest(CommandContext* ctx);
+void handleUsbStream(CommandContext* ctx);
+void handleUsbSof(CommandContext* ctx);
 
 void handleRxMode(CommandContext* ctx);
 void handleRxTimeout(CommandContext* ctx);
@@ -70,6 +95,16 @@ void handleBitPeriod(CommandContext* ctx);
 void handleRxMatchCount(CommandContext* ctx);
 void handleRxMinLength(CommandContext* ctx);
 void handleRxMaxLength(CommandContext* ctx);
+void handleRxHamming(CommandContext* ctx);
+void handleRxAdaptive(CommandContext* ctx);
+void handleRxInject(CommandContext* ctx);
+void handleRxRaw(CommandContext* ctx);
+void handleRxFilter(CommandContext* ctx);
+void handleRxGate(CommandContext* ctx);
+void handleRxSync(CommandContext* ctx);
+void handleRxSyncGap(CommandContext* ctx);
+void handleRxSyncHigh(CommandContext* ctx);
+void handleRxCheck(CommandContext* ctx);
 
 void handleTxLong(CommandContext* ctx);
 void handleTxShort(CommandContext* ctx);
@@ -77,5 +112,6 @@ void handleTxFrameDelay(CommandContext* ctx);
 void handleTxBurstDelay(CommandContext* ctx);
 void handleTxRepeat(CommandContext* ctx);
 void handleTxWord(CommandContext* ctx);
+void handleTxSlot(CommandContext* ctx);
 
 #endif /* INC_COMMANDS_H_ */
@@ -8,13 +8,22 @@
 #ifndef INC_CORE_MAIN_H_
 #define INC_CORE_MAIN_H_
 
+#include "scheduler.h"
+
 // system status flag and bit values
 extern uint32_t status;
 
+// main loop tasks, in priority order
+extern Task tasks[];
+extern const uint8_t task_count;
+
 // entry point funcs from main.cpp
 int USER_setup(void);
 int USER_loop(void);
 void USER_shutdown(void);
 void USER_error(void);
 
+// microsecond timestamp derived from the SysTick counter
+uint32_t micros(void);
+
 #endif /* INC_CORE_MAIN_H_ */
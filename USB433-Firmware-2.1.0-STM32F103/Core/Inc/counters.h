@@ -0,0 +1,61 @@
+/*
+ * counters.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#ifndef INC_COUNTERS_H_
+#define INC_COUNTERS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#define COUNTERS_FRAME_MAGIC0 0xA5 // binary counters frame: magic bytes, version, payload length,
+#define COUNTERS_FRAME_MAGIC1 0x5A //   little-endian uint32 payload, xor checksum of the payload
+#define COUNTERS_FRAME_VERSION 6
+
+// runtime counters; the payload of the binary frame in this order
+typedef struct {
+	uint32_t uptime_ms; // HAL tick when the counters were read
+	uint32_t edges; // input capture edges
+	uint32_t samples_overrun; // samples stored while the capture ring was full
+	uint32_t words_decoded; // words passed to the correlator
+	uint32_t words_correlated; // words reported after correlation
+	uint32_t words_rejected_len; // words dropped for their length
+	uint32_t tx_bursts; // transmit bursts started
+	uint32_t tx_frames; // transmit frames started
+	uint32_t usb_bytes_in; // bytes received from the USB host
+	uint32_t usb_bytes_out; // bytes queued to the USB host
+	uint32_t usb_busy_drops; // responses dropped because the USB queue was full
+	uint32_t loops_per_sec; // main loop passes over the last second
+	uint32_t gated_widths; // glitch pulses dropped by the minimum width gate
+	uint32_t gated_periods; // carrier notches dropped by the minimum period gate
+	uint32_t sync_arms; // times the sync detector started storing samples
+	uint32_t arena_failures; // words dropped or refused because the packet arena was full
+	uint32_t stream_bytes_out; // bytes queued to the stream interface
+	uint32_t stream_drops; // reports dropped because the stream queue was full
+	uint32_t words_validated; // words reported from their first frame on a passed checksum
+	uint32_t words_rejected_check; // words dropped for a failed checksum
+} Counters;
+
+#define COUNTERS_FRAME_SIZE (4 + sizeof(Counters) + 1)
+
+extern volatile Counters counters;
+extern uint32_t counters_stream_ms; // period of the binary counters stream; 0 when off
+
+void countersLoop(void);
+void countersReset(void);
+bool countersStreamDue(void);
+uint16_t countersStreamFrame(uint8_t* buf);
+uint16_t countersFrame(uint8_t* buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_COUNTERS_H_ */
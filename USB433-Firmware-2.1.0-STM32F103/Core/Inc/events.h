@@ -0,0 +1,41 @@
+/*
+ * events.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#ifndef INC_EVENTS_H_
+#define INC_EVENTS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// event flags posted by interrupt handlers to wake the main loop
+#define EVT_RX_EDGE 0x01 // input capture stored an edge
+#define EVT_TX_FRAME 0x02 // DMA finished sending a frame
+#define EVT_USB_RX 0x04 // command received from the USB host
+
+typedef struct {
+	bool sleep_enabled; // sleep with WFI while no event is pending
+	uint32_t wakes; // how many times pending events were taken
+	uint32_t last_cycles; // cycles from the first posted event to it being taken
+	uint32_t max_cycles; // worst wake-to-process latency, in cycles
+} EventStats;
+
+extern EventStats event_stats;
+
+void eventsInit(void);
+void postEvent(uint32_t events);
+uint32_t takeEvents(void);
+void waitForEvent(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_EVENTS_H_ */
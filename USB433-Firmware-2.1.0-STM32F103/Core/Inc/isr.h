@@ -0,0 +1,28 @@
+/*
+ * isr.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#ifndef INC_ISR_H_
+#define INC_ISR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the TIM2 capture and TX DMA interrupts are handled at register level by
+//   default; build with ISR_HAL_DISPATCH to route them through the HAL handlers
+#ifndef ISR_HAL_DISPATCH
+#define ISR_FAST_PATH
+#endif
+
+void rxCaptureIRQ(void);
+void txDmaIRQ(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_ISR_H_ */
@@ -0,0 +1,45 @@
+/*
+ * latency.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#ifndef INC_LATENCY_H_
+#define INC_LATENCY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stdint.h"
+
+#define LATENCY_HIST_BUCKETS 8 // bucket 0 is 0 ticks, then 1, 2-3, 4-7, ... and the last is open-ended
+
+// latencies are in timer ticks of TICK_PRESCALER cycles; only a build with
+//   TICK_PRESCALER 1 resolves single cycles of ISR entry
+
+typedef enum {
+	LATENCY_TIM2_CAPTURE = 0, // input capture edge to rxCaptureIRQ entry
+	LATENCY_DMA_TX, // TIM1 CC1 match of the last pulse (its DMA request loads the final CCR1) to txDmaIRQ entry
+	LATENCY_SOURCE_COUNT
+} LatencySource;
+
+typedef struct {
+	uint32_t count;
+	uint32_t max_ticks;
+	uint32_t sum_ticks;
+	uint32_t hist[LATENCY_HIST_BUCKETS];
+} LatencyStats;
+
+extern LatencyStats latency_stats[LATENCY_SOURCE_COUNT];
+extern const char* const latency_names[LATENCY_SOURCE_COUNT];
+
+void latencyRecord(LatencySource source, uint32_t ticks);
+void latencyReset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_LATENCY_H_ */
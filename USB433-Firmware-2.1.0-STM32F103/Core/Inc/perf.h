@@ -0,0 +1,67 @@
+/*
+ * perf.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#ifndef INC_PERF_H_
+#define INC_PERF_H_
+
+#include "stm32f1xx_hal.h"
+
+#include "stdint.h"
+
+// profiling is only built into debug builds
+#ifdef DEBUG
+#define PERF_ENABLED
+#endif
+
+#define PERF_HIST_BUCKETS 8 // histogram buckets; each is 4x wider than the last, starting at <64 cycles
+
+typedef enum {
+	PERF_CHECK_RX = 0, // checkRxBuffers()
+	PERF_RX_WORD, // receivedWord()
+	PERF_PROCESS_TX, // processTx()
+	PERF_PROCESS_USB, // processUSB()
+	PERF_CAPTURE_ISR, // TIM2 interrupt, from its dispatch
+	PERF_TX_DMA_ISR, // TX DMA interrupt, from its dispatch
+	PERF_RX_REPORT, // serializing a received word report
+	PERF_REGION_COUNT
+} PerfRegion;
+
+typedef struct {
+	uint32_t count;
+	uint32_t min_cycles;
+	uint32_t max_cycles;
+	uint64_t sum_cycles;
+	uint32_t hist[PERF_HIST_BUCKETS];
+} PerfStats;
+
+#ifdef PERF_ENABLED
+
+extern PerfStats perf_stats[PERF_REGION_COUNT];
+extern const char* const perf_names[PERF_REGION_COUNT];
+
+void perfRecord(PerfRegion region, uint32_t cycles);
+void perfReset(void);
+
+/*
+ * Times the enclosing scope with the DWT cycle counter
+ */
+struct PerfScope {
+	PerfRegion region;
+	uint32_t start;
+	PerfScope(PerfRegion r) : region(r), start(DWT->CYCCNT) {}
+	~PerfScope() { perfRecord(region, DWT->CYCCNT - start); }
+};
+
+#define PERF_SCOPE(region) PerfScope perf_scope_(region)
+
+#else
+
+#define PERF_SCOPE(region)
+
+#endif /* PERF_ENABLED */
+
+#endif /* INC_PERF_H_ */
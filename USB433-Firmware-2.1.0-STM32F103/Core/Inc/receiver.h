@@ -12,24 +12,68 @@
 
 #include "stdint.h"
 
+#include "arena.h"
+#include "ticks.h"
+
 #define RX_RADIO_EN_POLARITY true // true = active high; false = active low
 
-#define RX_MAX_BITS 64
-#define RX_BUFFER_SAMPLES 5*RX_MAX_BITS // TODO: update to 5 for release
+#define RX_MAX_BITS ARENA_MAX_BITS // longest word that can be received
+#define RX_DEFAULT_MAX_BITS 64 // default longest word reported
+#define RX_BUFFER_SAMPLES 320 // capture ring samples; 5 words of 64 bits
 #define RX_CORREL_WORDS 12
+#define RX_PACKED_WORDS ((RX_MAX_BITS + 1 + 31) / 32) // 32 bit words holding a received word and its sync bit as bits
+#define RX_HAMMING_MAX 16 // largest bit distance at which words can count as repeats
+#define RX_DECODE_SLICE 16 // max samples classified per call of checkRxBuffers
+#define RX_MODE_SAMPLES 48 // periods from the start of a chunk sorted for its most common period; bounds the first decoder slice
+#define RX_TRACKS 3 // transmissions that can be decoded at the same time
+#define RX_ARENA_RESERVE (2 * ((ARENA_MAX_BITS + 2 + ARENA_BLOCK_SIZE - 1) / ARENA_BLOCK_SIZE)) // arena blocks received words leave free: a queued tx word and a learned slot
+#define RX_LEARN_SOURCES 4 // number of signal sources to learn pulse timings for
+#define RX_LEARN_MIN_HITS 8 // pulses a source must see before its learned timings are trusted
+#define RX_SYNC_MAX_SAMPLES (RX_MAX_BITS + 1) // samples stored after a sync pulse before the detector disarms
+#define RX_FILTER_MAX 15 // highest TIM2 input filter setting (IC1F); 15 = 8 samples at 72 MHz / 4 / 32, ~14 us
+#define RX_PERIOD_LIM_Q8 333 // a track ends after this many bit periods without a rising edge; 1.3 in 8 bit fixed point
+#define RX_RAW_LINE_LEN (RX_DECODE_SLICE * 22 + 16) // "raw:" report of one decoder slice of samples
 
 // status flags
 #define RX_WORD_AVAILABLE 0x01
+#define RX_WORD_LEARNED 0x02 // a received word was stored to a tx slot
+#define RX_LEARN_FAILED 0x04 // a received word couldn't be stored to the tx slot being learned
 
 typedef struct {
 	uint8_t len = 0;
-	char word[RX_MAX_BITS+1];
-	uint32_t long_us = 0;
-	uint32_t short_us = 0;
-	uint32_t period_us = 0;
+	char* word = 0; // '0'/'1' string in the packet arena; 0 while empty
+	uint32_t long_ticks = 0; // word timings, in capture ticks
+	uint32_t short_ticks = 0;
+	uint32_t period_ticks = 0;
+	uint32_t gap_ticks = 0; // inter-word gap that terminated the word
+	uint32_t time_us = 0; // local time (micros) of the first rising edge of the word
 	bool logic = false;
 } RxPacket;
 
+typedef struct {
+	uint32_t period_ticks = 0; // learned bit period of the source
+	uint32_t short_ticks = 0; // learned short pulse width centroid
+	uint32_t long_ticks = 0; // learned long pulse width centroid
+	uint16_t hits = 0; // how many pulses have been used to learn the centroids
+	uint32_t last_seen_ms = 0; // when the source was last observed
+} RxTimingSource;
+
+// a transmission being decoded; pulses are assigned to it by their timing
+typedef struct {
+	bool active = false;
+	uint32_t period_ticks = 0; // bit period; follows the pulses assigned to the track
+	uint32_t last_rise_ticks = 0; // time of the last assigned rising edge, from the start of the chunk
+	uint32_t pending_width = 0; // width of the last pulse; classified once the next rise gives its period
+	uint16_t pulses = 0; // pulses assigned since the track started
+	RxTimingSource* src = 0; // learned timings of the source at this bit period
+	RxPacket packet; // word being built
+	uint32_t sum_short_ticks = 0; // timing sums over the bits of the word, for its reported timings
+	uint32_t sum_long_ticks = 0;
+	uint32_t sum_period_ticks = 0;
+	uint8_t timed_bits = 0;
+	bool dropped = false; // the word ran out of arena; its remaining pulses are followed but not stored
+} RxTrack;
+
 typedef struct {
 	uint8_t index = 0; // current word being written
 	uint32_t last_word_time_ms = 0; // when last word was injected
@@ -37,8 +81,12 @@ typedef struct {
 	RxPacket* last_match = 0;
 	uint32_t timeout_us = 100000; // microseconds after which the correl buffer gets cleared
 	uint8_t match_thresh = 3; // min number of repeated messages to be considered valid.
+	uint8_t hamming = 0; // max differing bits for words to count as repeats; 0 needs exact repeats
+	uint32_t packed[RX_CORREL_WORDS][RX_PACKED_WORDS]; // received words as bits, for distance and voting
+	uint32_t reported_packed[RX_PACKED_WORDS]; // bits of the last reported word; its ring slot may be reused
+	uint8_t reported_len = 0; // length of the last reported word; 0 if none
 	uint8_t min_word_len = 8; // min chars for a code to be valid
-	uint8_t max_word_len = RX_MAX_BITS;
+	uint8_t max_word_len = RX_DEFAULT_MAX_BITS;
 } RxCorrelBuffer;
 
 typedef struct {
@@ -46,13 +94,27 @@ typedef struct {
 	bool invert_logic = false;
 	bool ignore_sync_bit = true;
 	uint8_t mode = 2;
+	bool adaptive = true; // classify pulses against learned timings instead of fixed 50% duty
+	uint8_t learn_shift = 3; // EWMA weight of new pulses on learned timings, as 1/2^n
+	volatile bool blind = false; // radio disabled for transmit; captured edges are self-interference
+	bool raw = false; // report every decoded sample to the usb host
+	// noise gate, applied as edges are captured; 0 turns each off
+	uint8_t ic_filter = 0; // TIM2 input filter setting, 0 to RX_FILTER_MAX
+	uint16_t min_width_us = 0; // shorter high pulses are merged into the previous sample
+	uint16_t min_period_us = 0; // rising edges sooner than this after the last are ignored
+	// sync detector; while idle, samples are only stored from a sync pulse on
+	bool sync = false; // wait for a sync pulse before storing samples
+	uint32_t sync_gap_us = 4000; // minimum period of a sync pulse (its low gap), in us
+	uint16_t sync_high_us = 800; // maximum width of a sync pulse, in us
 	// buffer variables
 	uint16_t stor_idx = 0; // index of current sample to store
 	uint16_t proc_idx = 0; // index of final sample to process
 	uint16_t tgt_idx = 0; // target index for processing up to. Snapshots stor_idx-1 when word end detected
 	uint32_t bit_max_period = 5000; // set max bit period, in microseconds
-	uint32_t measured_periods[RX_BUFFER_SAMPLES]; // us, per timer prescaler
-	uint32_t measured_widths[RX_BUFFER_SAMPLES]; // us, per timer prescaler
+	uint32_t measured_periods[RX_BUFFER_SAMPLES]; // capture ticks
+	uint32_t measured_widths[RX_BUFFER_SAMPLES]; // capture ticks
+	// learned timings of recently seen signal sources
+	RxTimingSource sources[RX_LEARN_SOURCES];
 	// correlation buffer struct (for word repetition detect)
 	RxCorrelBuffer correl;
 } Receiver;
@@ -63,6 +125,8 @@ extern uint32_t status;
 
 void rxInit(Receiver* settings);
 
+void setRxFilter(uint8_t filter);
+
 bool isRxEnabled(void);
 void enableRx(void);
 void disableRx(void);
@@ -70,10 +134,19 @@ void disableRx(void);
 //////////////////////////////////////////////////
 
 void clearRxPacket(RxPacket* buf);
+bool appendRxBit(RxPacket* buf, char bit);
+
+RxTimingSource* findTimingSource(uint32_t period_ticks);
+void learnPulse(RxTimingSource* src, uint32_t width_ticks, bool is_short);
 
 void rxWordRepeated(char *buffer, size_t size);
 void receivedWord(RxCorrelBuffer* correl, RxPacket* data);
-void checkRxBuffers(void);
+bool isCorrelRepeat(RxCorrelBuffer* correl, uint8_t index);
+bool checkRxBuffers(void);
+
+bool rxInjectReady(void);
+bool injectRxSample(uint32_t period_us, uint32_t width_us);
+void injectRxEnd(bool keep);
 
 void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim);
 
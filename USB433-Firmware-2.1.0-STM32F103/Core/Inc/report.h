@@ -0,0 +1,34 @@
+/*
+ * report.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#ifndef INC_REPORT_H_
+#define INC_REPORT_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#define REPORT_RESERVE 3 // bytes held back from fields so a line can always be ended with "\r\n"
+
+// a text report being built into a caller's buffer; the buffer is kept null terminated
+typedef struct {
+	char* buf;
+	uint16_t size; // bytes in buf
+	uint16_t len; // characters written
+	bool overflow; // a field was dropped for lack of space
+} Report;
+
+void reportBegin(Report* report, char* buf, uint16_t size);
+void reportChar(Report* report, char c);
+void reportStr(Report* report, const char* str);
+void reportU32(Report* report, uint32_t value);
+void reportI32(Report* report, int32_t value);
+void reportU32Pad(Report* report, uint32_t value, uint8_t width);
+void reportHex(Report* report, uint32_t value, uint8_t digits);
+void reportField(Report* report, const char* name, uint32_t value);
+void reportEnd(Report* report);
+
+#endif /* INC_REPORT_H_ */
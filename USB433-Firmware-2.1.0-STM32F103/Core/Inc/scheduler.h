@@ -0,0 +1,27 @@
+/*
+ * scheduler.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#ifndef INC_SCHEDULER_H_
+#define INC_SCHEDULER_H_
+
+#include "stdint.h"
+
+typedef struct {
+	const char* name;
+	bool (*ready)(uint32_t events); // whether the task has work, given the pending events
+	bool (*run)(void); // run to completion; returns true if more work is waiting right away
+	uint32_t budget_cycles; // allowed execution time of a single run, in CPU cycles
+	// statistics
+	uint32_t runs = 0; // how many times the task has run
+	uint32_t wcet_cycles = 0; // worst-case execution time observed, in CPU cycles
+	uint32_t overruns = 0; // runs that took longer than the budget
+} Task;
+
+bool runTasks(Task* tasks, uint8_t count, uint32_t events);
+void resetTaskStats(Task* tasks, uint8_t count);
+
+#endif /* INC_SCHEDULER_H_ */
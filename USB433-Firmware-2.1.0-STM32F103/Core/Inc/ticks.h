@@ -0,0 +1,34 @@
+/*
+ * ticks.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#ifndef INC_TICKS_H_
+#define INC_TICKS_H_
+
+#include "stdint.h"
+
+// TIM2 capture and TIM1 generation count in ticks of TICK_PRESCALER timer
+//   clocks (72 MHz). It must divide 72: 72 gives 1 us ticks, 1 gives 1/72 us.
+//   Finer ticks shorten the longest TX bit period, which has to fit the 16 bit
+//   TIM1 count (910 us at 1/72 us; the default 300/700 us pulses need 4 or
+//   more, or shorter TX_DEFAULT_*_US; transmitter.h asserts it), and raise the
+//   TIM2 overflow rate.
+#ifndef TICK_PRESCALER
+#define TICK_PRESCALER 72
+#endif
+
+#if (72 % TICK_PRESCALER) != 0
+#error "TICK_PRESCALER must divide 72"
+#endif
+
+#define TICKS_PER_US (72 / TICK_PRESCALER)
+#define TICKS_MAX_US (UINT32_MAX / TICKS_PER_US) // longest time US_TO_TICKS converts without overflow
+
+// conversions at the host interface, which is in microseconds
+#define US_TO_TICKS(us) ((uint32_t) (us) * TICKS_PER_US)
+#define TICKS_TO_US(ticks) (((uint32_t) (ticks) + TICKS_PER_US / 2) / TICKS_PER_US)
+
+#endif /* INC_TICKS_H_ */
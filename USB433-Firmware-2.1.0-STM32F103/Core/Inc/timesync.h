@@ -0,0 +1,43 @@
+/*
+ * timesync.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#ifndef INC_TIMESYNC_H_
+#define INC_TIMESYNC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#define TIMESYNC_WINDOW_FRAMES 1024 // frames over which the local clock rate is measured
+#define TIMESYNC_RATE_SHIFT 2 // EWMA weight of a new rate measurement, as 1/2^n
+#define TIMESYNC_RATE_TOL_Q16 (65 << 16) // measurements further than 65 us/frame (6.5%) from nominal are dropped
+#define TIMESYNC_STALE_US 50000 // mapping is invalid once no SOF has been seen for this long
+#define TIMESYNC_FRAME_MASK 0x7FF // SOF frame numbers are 11 bits
+
+// mapping of local time (micros()) to the host's USB frame timeline, from the latest SOF
+typedef struct {
+	uint16_t frame; // frame number of the latest SOF
+	uint32_t local_us; // local time the latest SOF was latched
+	uint32_t us_per_frame_q16; // local microseconds per host frame, 16.16 fixed point
+	uint32_t sofs; // SOF interrupts seen
+	bool calibrated; // us_per_frame_q16 has been measured
+} TimeSync;
+
+extern volatile TimeSync timesync;
+
+void timesyncSOF(void);
+void timesyncLatch(TimeSync* out);
+bool timesyncMap(uint32_t local_us, uint16_t* frame, uint16_t* frame_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_TIMESYNC_H_ */
@@ -0,0 +1,52 @@
+/*
+ * trace.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#ifndef INC_TRACE_H_
+#define INC_TRACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#define TRACE_RECORDS 64 // records kept in the ring; must be a power of 2
+#define TRACE_FRAME_MAGIC0 0xA5 // binary trace dump: magic bytes, version, record count,
+#define TRACE_FRAME_MAGIC1 0x54 //   cycles per microsecond, records oldest first, xor checksum of the records
+#define TRACE_FRAME_VERSION 1
+
+typedef enum {
+	TRACE_EDGE = 0, // arg8: capture channel (1 rising, 2 falling), arg16: captured ticks
+	TRACE_GAP, // arg16: word gap period, in us (saturated)
+	TRACE_WORD, // arg8: word length, arg16: 1 if correlated
+	TRACE_TX_START, // arg8: frame number
+	TRACE_TX_STOP, // arg8: frame number
+	TRACE_USB_IN, // arg16: bytes received
+	TRACE_USB_OUT, // arg16: bytes transmitted
+	TRACE_EVENT_COUNT
+} TraceEvent;
+
+// 8 byte record; also the layout of a record in a dump
+typedef struct {
+	uint32_t cycles; // DWT cycle counter at the event
+	uint8_t event;
+	uint8_t arg8;
+	uint16_t arg16;
+} TraceRecord;
+
+extern volatile uint32_t trace_mask; // bit per TraceEvent that gets recorded; 0 turns tracing off
+
+void traceRecord(TraceEvent event, uint8_t arg8, uint16_t arg16);
+void traceClear(void);
+uint16_t traceDump(uint8_t* buf, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_TRACE_H_ */
@@ -11,8 +11,25 @@
 
 #include "stdint.h"
 
+#include "arena.h"
+#include "receiver.h"
+#include "ticks.h"
+
 #define TX_BUFFER_LEN 5 // length of words that can be buffered
-#define TX_MAX_BITS 64 // max length of a word to transmit
+#define TX_MAX_BITS ARENA_MAX_BITS // max length of a word to transmit
+#define TX_SLOTS 4 // number of learned waveforms that can be stored for replay
+#define TX_MAX_PERIOD_TICKS (UINT16_MAX + 1UL) // longest bit period the 16 bit TIM1 count holds
+#define TX_MAX_PULSE_US ((UINT16_MAX >> 2) / TICKS_PER_US) // longest pulse setting
+#ifndef TX_DEFAULT_SHORT_US
+#define TX_DEFAULT_SHORT_US 300 // default tx pulses; a finer TICK_PRESCALER may need shorter ones
+#endif
+#ifndef TX_DEFAULT_LONG_US
+#define TX_DEFAULT_LONG_US 700
+#endif
+
+static_assert(TX_DEFAULT_LONG_US <= TX_MAX_PULSE_US
+		&& (TX_DEFAULT_SHORT_US + TX_DEFAULT_LONG_US) * TICKS_PER_US <= TX_MAX_PERIOD_TICKS,
+		"default tx pulses don't fit TIM1 at this TICK_PRESCALER");
 
 #define TX_BUFFER_EMPTY 0x01 // no data to transmit
 #define TX_PREP_FAILED 0x02 // invalid characters caused transmit buffer to fail
@@ -23,33 +40,56 @@ typedef struct {
 	bool burst_complete = true; // indicates burst of frames is complete
 	uint8_t frames_sent = 0; // how many total frames have been sent
 	uint32_t last_frame_time_ms = 0; // when the last frame completed
-	uint16_t dma_buffer[TX_MAX_BITS + 1]; // buffer to use for DMA transmission; holds duty cycle (timer CCR) values
+	uint16_t dma_buffer[TX_MAX_BITS + 2]; // buffer to use for DMA transmission; holds duty cycle (timer CCR) values
 	uint16_t dma_len = 0; // counter for how many bits to send for packet
+	uint32_t frame_delay_us = 0; // delay between frames of this burst
+	uint8_t frame_repeat = 0; // how many times the frame of this burst gets repeated
+	uint32_t blind_start_us = 0; // when the receiver was disabled for this burst
+	uint32_t blind_us = 0; // how long the receiver was disabled for this burst
 } TxPacket;
 
+typedef struct {
+	bool valid = false; // slot holds a learned waveform
+	bool invert_logic = false; // logic format the word was received with
+	uint16_t t_short_ticks = 0; // time of short pulse, in timer ticks
+	uint16_t t_long_ticks = 0; // time of long pulse, in timer ticks
+	uint32_t frame_delay_us = 0; // time between frames, in microseconds
+	uint8_t frame_repeat = 0; // how many times the frame gets repeated
+	char* word = 0; // word to transmit, including any sync bit; held in the packet arena
+} TxSlot;
+
 typedef struct {
 	// data structure params
 	bool invert_logic = false; // true: long high == 1; false: long high == 0
 	bool ignore_sync_bit = false; // word is n bits long; if true, prepend a long-high bit to the start to sync data to known state
 	// timing params
-	uint16_t t_short = 300; // time of short pulse, in microseconds
-	uint16_t t_long = 700; // time of long pulse, in microseconds
+	uint16_t t_short = TX_DEFAULT_SHORT_US; // time of short pulse, in microseconds
+	uint16_t t_long = TX_DEFAULT_LONG_US; // time of long pulse, in microseconds
 	uint32_t frame_delay_us = 6600; // time between sending the same frame of data, in microseconds
 	uint32_t burst_delay_us = 100000; // time between sending packets of different data
 	// data transmission params
 	uint8_t frame_repeat = 7; // by default, send once and repeat n times
-	char buffer[TX_BUFFER_LEN][TX_MAX_BITS];
+	char* buffer[TX_BUFFER_LEN] = {}; // queued words in the packet arena; 0 marks a free entry
+	uint8_t buffer_slot[TX_BUFFER_LEN]; // 0: buffered word uses the settings above; n: word replays slot n-1
+	// learned waveforms
+	TxSlot slots[TX_SLOTS];
+	int8_t learn_slot = -1; // slot to store the next received word to; -1 when not learning
 
 } Transmitter;
 
 extern TIM_HandleTypeDef htim1;
+extern DMA_HandleTypeDef hdma_tim1_ch1;
 extern Transmitter tx;
 extern TxPacket data;
 
 void txInit(Transmitter* settings);
-void updateARR(Transmitter* settings);
+bool updateARR(Transmitter* settings);
 void makeTxPacket(Transmitter* settings, TxPacket* packet);
 void processTx(Transmitter* settings, TxPacket* packet);
+void resumeRxAfterTx(TxPacket* packet);
+bool learnTxSlot(Transmitter* settings, uint8_t slot, RxPacket* packet, uint8_t repeats, bool sync_bit);
+bool queueTxSlot(Transmitter* settings, uint8_t slot);
+bool isTxActive(void);
 
 
 #endif /* INC_TRANSMITTER_H_ */
@@ -0,0 +1,39 @@
+/*
+ * validate.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#ifndef INC_VALIDATE_H_
+#define INC_VALIDATE_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#define RX_VALIDATORS 4 // checksum validators that can be configured
+
+// validator types; the check field is the last 'width' bits of the word, and
+//   is computed over the bits in front of it, first bit first
+#define VALIDATE_OFF 0
+#define VALIDATE_CRC 1 // CRC-<width> with polynomial 'poly', register preset to 'init'
+#define VALIDATE_XOR 2 // xor of the <width> bit symbols of the data, xor 'init'
+#define VALIDATE_SUM 3 // sum of the <width> bit symbols of the data plus 'init', mod 2^width
+#define VALIDATE_LFSR 4 // LFSR digest: xor of the key at each set bit; the key starts at 'init' and shifts right through generator 'poly' every bit
+#define VALIDATE_TYPES 5
+
+typedef struct {
+	uint8_t type = VALIDATE_OFF;
+	uint8_t len = 0; // length of the words checked, including a sync bit if it's kept
+	uint8_t width = 8; // bits of the check field, 1 to 32
+	uint32_t poly = 0; // CRC polynomial (top bit implied) or LFSR generator
+	uint32_t init = 0; // CRC preset, xor or sum offset, or LFSR key
+} RxValidator;
+
+extern RxValidator validators[RX_VALIDATORS];
+extern const char* const validator_names[VALIDATE_TYPES];
+
+RxValidator* findValidator(uint8_t len);
+bool validateWord(const RxValidator* validator, const uint32_t* packed, uint8_t len);
+
+#endif /* INC_VALIDATE_H_ */
@@ -0,0 +1,130 @@
+/*
+ * arena.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ *
+ * Fixed-size pool for variable length words. Storage is handed out in runs of
+ * contiguous blocks, tracked by a bitmap, so long words only take the space
+ * they need and nothing is allocated from the heap.
+ */
+
+#include "string.h"
+#include "stdint.h"
+
+#include "arena.h"
+
+#define ARENA_MAP_WORDS ((ARENA_BLOCKS + 31) / 32)
+#define ARENA_BLOCKS_FOR(bytes) (((bytes) + ARENA_BLOCK_SIZE - 1) / ARENA_BLOCK_SIZE)
+
+static char arena[ARENA_BLOCKS * ARENA_BLOCK_SIZE] __attribute__((aligned(4)));
+static uint32_t arena_used[ARENA_MAP_WORDS]; // bit per block in use
+static uint8_t arena_run[ARENA_BLOCKS]; // blocks in the slot starting at each block
+
+static bool blockUsed(uint16_t block) {
+	return arena_used[block >> 5] & (1UL << (block & 31));
+}
+
+static void markBlocks(uint16_t first, uint16_t count, bool used) {
+	for (uint16_t b = first; b < first + count; b++) {
+		if (used)
+			arena_used[b >> 5] |= 1UL << (b & 31);
+		else
+			arena_used[b >> 5] &= ~(1UL << (b & 31));
+	}
+}
+
+static uint16_t blockOf(const char* ptr) {
+	return (ptr - arena) / ARENA_BLOCK_SIZE;
+}
+
+/*
+ * Allocate a zeroed slot of at least 'bytes'. Returns 0 if no run of free
+ * blocks is long enough.
+ */
+char* arenaAlloc(uint16_t bytes) {
+	uint16_t count = ARENA_BLOCKS_FOR(bytes ? bytes : 1);
+	uint16_t run = 0;
+	for (uint16_t b = 0; b < ARENA_BLOCKS; b++) {
+		if (blockUsed(b)) {
+			run = 0;
+			continue;
+		}
+		if (++run == count) {
+			// first fit
+			uint16_t first = b + 1 - count;
+			markBlocks(first, count, true);
+			arena_run[first] = count;
+			char* ptr = &arena[first * ARENA_BLOCK_SIZE];
+			memset(ptr, 0, count * ARENA_BLOCK_SIZE);
+			return ptr;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Change the size of a slot, keeping its content. Shrinking and growing into
+ * free blocks that follow happen in place; otherwise the content moves to a
+ * new slot. Returns the slot, or 0 (leaving 'ptr' untouched) if there's no room.
+ */
+char* arenaResize(char* ptr, uint16_t bytes) {
+	if (!ptr)
+		return arenaAlloc(bytes);
+
+	uint16_t first = blockOf(ptr);
+	uint16_t count = arena_run[first];
+	uint16_t wanted = ARENA_BLOCKS_FOR(bytes ? bytes : 1);
+	if (wanted <= count) {
+		markBlocks(first + wanted, count - wanted, false);
+		arena_run[first] = wanted;
+		return ptr;
+	}
+
+	uint16_t end = first + count;
+	while (end < first + wanted && end < ARENA_BLOCKS && !blockUsed(end))
+		end++;
+	if (end == first + wanted) {
+		memset(&arena[(first + count) * ARENA_BLOCK_SIZE], 0, (wanted - count) * ARENA_BLOCK_SIZE);
+		markBlocks(first + count, wanted - count, true);
+		arena_run[first] = wanted;
+		return ptr;
+	}
+
+	char* moved = arenaAlloc(bytes);
+	if (!moved)
+		return 0;
+	memcpy(moved, ptr, count * ARENA_BLOCK_SIZE);
+	arenaFree(ptr);
+	return moved;
+}
+
+/*
+ * Return a slot to the arena; null is ignored
+ */
+void arenaFree(char* ptr) {
+	if (!ptr)
+		return;
+	uint16_t first = blockOf(ptr);
+	markBlocks(first, arena_run[first], false);
+	arena_run[first] = 0;
+}
+
+/*
+ * Bytes a slot can hold; 0 for null
+ */
+uint16_t arenaCapacity(const char* ptr) {
+	return ptr ? arena_run[blockOf(ptr)] * ARENA_BLOCK_SIZE : 0;
+}
+
+/*
+ * Count the blocks not in use
+ */
+uint16_t arenaFreeBlocks(void) {
+	uint16_t count = 0;
+	for (uint16_t b = 0; b < ARENA_BLOCKS; b++) {
+		if (!blockUsed(b))
+			count++;
+	}
+	return count;
+}
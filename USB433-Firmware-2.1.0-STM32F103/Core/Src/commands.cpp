@@ -6,8 +6,8 @@
  */
 
 #include "usbd_cdc_if.h"
+#include "usbd_stream_if.h"
 
-#include "inttypes.h"
 #include "ctype.h"
 
 #include "main.h"
@@ -15,6 +15,15 @@
 #include "commands.h"
 #include "transmitter.h"
 #include "receiver.h"
+#include "events.h"
+#include "perf.h"
+#include "latency.h"
+#include "counters.h"
+#include "arena.h"
+#include "timesync.h"
+#include "trace.h"
+#include "report.h"
+#include "validate.h"
 
 // USB RX / TX buffers
 char usb_tx_buffer[TX_BUFFER_SIZE];
@@ -22,21 +31,46 @@ char usb_tx_buffer[TX_BUFFER_SIZE];
 // tracking variable for last activity time on USB, in millis
 uint32_t last_USB_time = 0;
 
+bool usb_stream_reports = false; // send asynchronous reports on the stream interface instead of the CDC port
+
+static uint32_t usb_test_remaining = 0; // bytes of the throughput test stream still to be queued
+static uint32_t usb_test_offset = 0; // index of the next test stream byte
+
 // Child nodes for "rx word"
 const CommandNode rx_word_commands[] = {
 	{ "matchcount", handleRxMatchCount, 0, 0 },
 	{ "timeout", handleRxTimeout, 0, 0 },
 	{ "minlength", handleRxMinLength, 0, 0 },
-	{ "maxlength", handleRxMaxLength, 0, 0 }
+	{ "maxlength", handleRxMaxLength, 0, 0 },
+	{ "hamming", handleRxHamming, 0, 0 }
+};
+
+// Child nodes for "rx gate"
+const CommandNode rx_gate_commands[] = {
+	{ "width", handleRxGate, 0, 0 },
+	{ "period", handleRxGate, 0, 0 }
+};
+
+// Child nodes for "rx sync"
+const CommandNode rx_sync_commands[] = {
+	{ "gap", handleRxSyncGap, 0, 0 },
+	{ "high", handleRxSyncHigh, 0, 0 }
 };
 
 // Child nodes for "rx"
 const CommandNode rx_commands[] = {
 	{ "mode", handleRxMode, 0, 0 },
 	{ "bitperiod", handleBitPeriod, 0, 0 },
-	{ "word", 0 , rx_word_commands, 4 },
+	{ "word", 0 , rx_word_commands, 5 },
 	{ "ignoresyncbit", handleSyncBit, 0, 0},
-	{ "logic", handleLogic, 0, 0 }
+	{ "logic", handleLogic, 0, 0 },
+	{ "adaptive", handleRxAdaptive, 0, 0 },
+	{ "inject", handleRxInject, 0, 0 },
+	{ "raw", handleRxRaw, 0, 0 },
+	{ "filter", handleRxFilter, 0, 0 },
+	{ "gate", 0, rx_gate_commands, 2 },
+	{ "sync", handleRxSync, rx_sync_commands, 2 },
+	{ "check", handleRxCheck, 0, 0 }
 };
 
 // Child nodes for "tx time"
@@ -57,15 +91,64 @@ const CommandNode tx_commands[] = {
 	{ "delay", 0, tx_delay_commands, 2 },
 	{ "ignoresyncbit", handleSyncBit, 0, 0 },
 	{ "repeat", handleTxRepeat, 0, 0 },
-	{ "logic", handleLogic, 0, 0 }
+	{ "logic", handleLogic, 0, 0 },
+	{ "slot", handleTxSlot, 0, 0 }
+};
+
+// Child nodes for "sleep"
+const CommandNode sleep_commands[] = {
+	{ "latency", handleSleepLatency, 0, 0 }
+};
+
+// Child nodes for "irq priority"
+const CommandNode irq_priority_commands[] = {
+	{ "tim2", handleIrqPriority, 0, 0 },
+	{ "dma", handleIrqPriority, 0, 0 },
+	{ "usb", handleIrqPriority, 0, 0 }
+};
+
+// Child nodes for "irq"
+const CommandNode irq_commands[] = {
+	{ "latency", handleIrqLatency, 0, 0 },
+	{ "priority", 0, irq_priority_commands, 3 }
+};
+
+// Child nodes for "counters"
+const CommandNode counters_commands[] = {
+	{ "binary", handleCountersBinary, 0, 0 },
+	{ "stream", handleCountersStream, 0, 0 }
+};
+
+// Child nodes for "trace"
+const CommandNode trace_commands[] = {
+	{ "dump", handleTraceDump, 0, 0 },
+	{ "clear", handleTraceClear, 0, 0 },
+	{ "enable", handleTraceEnable, 0, 0 }
+};
+
+// Child nodes for "usb"
+const CommandNode usb_commands[] = {
+	{ "test", handleUsbTest, 0, 0 },
+	{ "stream", handleUsbStream, 0, 0 },
+	{ "sof", handleUsbSof, 0, 0 }
 };
 
 // Top-level commands
 const CommandNode usb_nodes[] = {
-    { "rx", 0, rx_commands, 5 },
-    { "tx", handleTxWord, tx_commands, 5 },
+    { "rx", 0, rx_commands, 12 },
+    { "tx", handleTxWord, tx_commands, 6 },
 	{ "status", handleStatus, 0, 0, },
-	{ "version", handleVersion, 0, 0 }
+	{ "version", handleVersion, 0, 0 },
+	{ "learn", handleLearn, 0, 0 },
+	{ "sleep", handleSleep, sleep_commands, 1 },
+	{ "tasks", handleTasks, 0, 0 },
+	{ "irq", 0, irq_commands, 2 },
+	{ "counters", handleCounters, counters_commands, 2 },
+	{ "trace", 0, trace_commands, 3 },
+	{ "usb", 0, usb_commands, 3 },
+#ifdef PERF_ENABLED
+	{ "perf", handlePerf, 0, 0 }
+#endif
 };
 
 #define USB_COMMAND_COUNT (sizeof(usb_nodes) / sizeof(CommandNode))
@@ -104,18 +187,18 @@ bool dispatch(const CommandNode* nodes, uint8_t count, CommandContext* ctx, int
 				return true;
 			} else if (!child_handled && index + 1 < ctx->argc) {
 				// child didn't handle, and there's an extra param; so the param must be bad
-				sprintf(usb_tx_buffer, "%u %s\r\n", USB_CC_BAD_PARAM, ctx->argv[index+1]);
+				bufferCodeText(USB_CC_BAD_PARAM, ctx->argv[index+1]);
 				return true;
 			} else if (!child_handled) {
 				// child didn't handle, and there's no handler here; we must be missing a param
-				sprintf(usb_tx_buffer, "%u\r\n", USB_CC_MISSING_PARAM);
+				bufferCode(USB_CC_MISSING_PARAM);
 				return true;
 			}
 
 			return child_handled;
 		}
 	}
-	sprintf(usb_tx_buffer, "%u %s\r\n", USB_CC_UNKNOWN, ctx->argv[index]);
+	bufferCodeText(USB_CC_UNKNOWN, ctx->argv[index]);
 	return false;
 }
 
@@ -124,6 +207,41 @@ bool dispatch(const CommandNode* nodes, uint8_t count, CommandContext* ctx, int
  * ****** RECEIVER USER PARAMETERS ******
  *  // TODO: allow for hex string data sending
  *  - status						// return the value of the 'status' variable
+ *  - learn							// store the next valid received word to the first empty tx slot; returns the slot
+ *  - learn <uint8_t>				// store the next valid received word to the given tx slot
+ *  - sleep							// get whether the core sleeps (WFI) between events
+ *  - sleep <0:1>					// set whether the core sleeps between events
+ * 		+ latency					// get last and max cycles from an interrupt event to the main loop taking it
+ * 		+ latency reset				// reset the event latency statistics
+ *  - tasks							// get runs, worst-case cycles, budget cycles and overruns of each main loop task
+ *  - tasks reset					// reset the task statistics
+ *  - irq ...
+ * 		+ latency					// get entry latency stats, in timer ticks, of the tim2 capture and dma tx complete interrupts;
+ *									//   a tick is TICK_PRESCALER cycles, so build with TICK_PRESCALER 1 for cycle resolution
+ * 		+ latency reset				// reset the interrupt latency statistics
+ * 		+ priority ...
+ * 			+ <tim2:dma:usb>		// get NVIC preemption priority of the interrupt
+ * 			+ <tim2:dma:usb> <0-15>	// set NVIC preemption priority of the interrupt (0 = highest)
+ *  - counters						// get the runtime counters as text, plus the free packet arena blocks
+ *  - counters reset				// zero the runtime counters
+ * 		+ binary					// get the runtime counters as one binary frame (see COUNTERS FRAME below)
+ * 		+ stream					// get the period of the binary counters stream, in milliseconds
+ * 		+ stream <uint32_t>			// send a binary counters frame every period, in milliseconds (0 = off)
+ *  - trace ...
+ * 		+ dump						// get the trace ring as one binary dump (see TRACE DUMP below)
+ * 		+ clear						// drop all trace records
+ * 		+ enable					// get the mask of recorded trace events (bit n = TraceEvent n in trace.h)
+ * 		+ enable <uint32_t>			// set the mask of recorded trace events (0 = off)
+ *  - usb ...
+ * 		+ test						// get how many bytes of the throughput test are still to be queued
+ * 		+ test <uint32_t>			// stream n bytes of test pattern to the host (see USB TEST STREAM below)
+ * 		+ stream					// get whether asynchronous reports go to the stream interface
+ * 		+ stream <0:1>				// send received words, tx status, raw samples, the counters stream and
+ *									//   the usb test stream on the vendor bulk stream interface (interface 2,
+ *									//   endpoint 0x83) instead of the CDC port (see STREAM INTERFACE below)
+ * 		+ sof						// get the latest SOF time latch (see SOF TIME SYNC below)
+ *  - perf							// (debug builds) get cycle count stats of each profiled region, one line per region
+ *  - perf reset					// (debug builds) reset the profiling statistics
  *  - rx ...						// receive commands
  * 		+ mode 						// get current rx mode
  * 		+ mode <0:1:2>				// set rx mode: 0=always off, 1=always on, 2=off during transmit
@@ -135,13 +253,47 @@ bool dispatch(const CommandNode* nodes, uint8_t count, CommandContext* ctx, int
  * 			+ minlength				// minimum length of a received word; shorter words get discarded
  * 			+ minlength <uint8_t>	// set minimum length of a received word;
  * 			+ maxlength				// maximum length of a received word; longer words get discarded
- * 			+ maxlength <uint8_t>	// set maximum length of a received word;
+ * 			+ maxlength <uint8_t>	// set maximum length of a received word; up to 128 bits (default 64)
+ * 			+ hamming				// get how many bits words may differ in to count as repeats
+ * 			+ hamming <0-16>		// set the repeat bit tolerance; the reported word is the per-bit majority of its repeats (0 = exact)
  * 			+ timeout				// get timeout for receive correlation buffer; clear buffer if nothing received after timeout, in microseconds
  *	 		+ timeout <uint32_t>	// set timeout for rx correlation buffer, in microseconds
  *		+ ignoresyncbit				// get status of whether sync bit should be ignored
  *		+ ignoresyncbit <0:1>		// set whether sync bit should be ignored (0=no, 1=yes)
  *		+ logic						// get receiver logic format; 0:long high == 0; 1: long high == 1
  * 		+ logic <1:0>				// set receiver logic format
+ *		+ adaptive					// get whether pulses are classified against learned source timings
+ *		+ adaptive <0:1>			// set adaptive timing classification (0=fixed 50% duty, 1=learned)
+ *		+ inject <p,w,p,w,...>		// decode comma separated (period, width) samples, in us, as one captured chunk;
+ *									//   a trailing comma continues the chunk in the next inject command
+ *									//   (a command must fit in one 64 byte USB packet).
+ *									//   Needs rx mode 0, an idle decoder and no transmission, else returns BUSY
+ *		+ raw						// get whether every decoded sample is reported
+ *		+ raw <0:1>					// set whether every decoded sample is reported (see RAW SAMPLE SENTENCE)
+ *		+ filter					// get the TIM2 input filter setting
+ *		+ filter <0-15>				// set the TIM2 input filter; edges must be stable for up to ~14 us (0 = off)
+ *		+ gate ...					// software noise gate at capture time (0 = off)
+ *			+ width					// get minimum high pulse width, in us
+ *			+ width <uint16_t>		// set minimum high pulse width; shorter pulses merge into the previous sample
+ *			+ period				// get minimum period between rising edges, in us
+ *			+ period <uint16_t>		// set minimum period; sooner rising edges (carrier notches) are ignored
+ *		+ sync						// get whether samples are only stored after a sync pulse
+ *		+ sync <0:1>				// set whether to wait for a sync pulse (short high, long low) before storing samples
+ *			+ gap					// get minimum period of a sync pulse, in us
+ *			+ gap <uint32_t>		// set minimum period of a sync pulse, in us
+ *			+ high					// get maximum high width of a sync pulse, in us
+ *			+ high <uint16_t>		// set maximum high width of a sync pulse, in us
+ *		+ check <0-3>				// get checksum validator n: "<type> len:<n> width:<n> poly:<hex> init:<hex>"
+ *		+ check <0-3> off			// remove checksum validator n
+ *		+ check <0-3> <crc:xor:sum:lfsr> <len> <width> [poly] [init]
+ *									// check words of <len> bits (with the sync bit if kept) against their
+ *									//   last <width> bits: crc = CRC-<width> of the bits in front, MSB first,
+ *									//   with 'poly' (top bit implied) preset to 'init'; xor/sum = xor or sum
+ *									//   of the <width> bit symbols in front, with 'init'; lfsr = xor of the
+ *									//   key (from 'init', shifted right through generator 'poly' every bit)
+ *									//   at each set bit. poly and init take 0x hex. A word that passes is
+ *									//   reported from its first frame, once per burst; a word that fails is
+ *									//   dropped. Words of other lengths still need matchcount repeats
  *
  * 	- tx ...						// transmit commands; if blank, returns any queued data or MISSING_PARAM error
  * 		+ time ...					// timing parameters
@@ -158,17 +310,68 @@ bool dispatch(const CommandNode* nodes, uint8_t count, CommandContext* ctx, int
  * 		+ ignoresyncbit <0:1>		// set whether a sync bit should be transmitted
  * 		+ repeat					// get how many times a transmit frame gets repeated
  * 		+ repeat <uint8_t>			// set how many times a transmit frame gets repeated
- * 		+ <sequence of 0:1>			// transmit a word, defined by a string of up to 64 binary 1:0 chars.
+ * 		+ <sequence of 0:1>			// transmit a word, defined by a string of up to 128 binary 1:0 chars;
+ *									//   a command must fit in one 64 byte USB packet, so longer words
+ *									//   are sent from learned slots
  *		+ logic						// get transmitter logic format; 0:long high == 0; 1: long high == 1
  * 		+ logic <1:0>				// set transmitter logic format
+ * 		+ slot <uint8_t>			// transmit a learned slot with the timing it was received with
  *
  *
  *	****** RECEIVER OUTPUT SENTENCE ******
  *	<status> word:<0:1 string> len:<length of word> long_us:<us> short_us:<us> period_us:<us> logic:0 ignoresync:1
+ *		local_us:<us> sof:<frame>.<us>
  *		// when the receiver detects a valid word, transmit it to the usb host
  *		// with timing information and logic assumption
+ *	<status> slot:<n> word:<0:1 string> long_us:<us> short_us:<us> delay_us:<us> repeat:<n> logic:0
+ *		// after a "learn" command, the next valid word is stored to the slot and reported
+ *	<status> slot:<n>
+ *		// a "learn" that failed: the word's timing doesn't fit the transmitter, or the packet arena
+ *		// is full. Learning stops; the slot keeps what it held
+ *
+ *	0 raw:<period>,<width> <period>,<width> ...
+ *		// with "rx raw 1", the samples of each decoder slice in us, in capture order
+ *
+ *	****** TRANSMITTER OUTPUT SENTENCE ******
+ *	<status> <0:1 string> blind_start_us:<us> blind_us:<us>
+ *		// when a burst completes; in rx mode 2 the receiver was disabled from blind_start_us
+ *		// (device microsecond clock) for blind_us, otherwise both are 0
+ *
+ *	****** COUNTERS FRAME ******
+ *	0xA5 0x5A <version> <payload length> <payload> <xor of payload bytes>
+ *		// payload is the Counters struct (counters.h) as little-endian uint32 fields:
+ *		// uptime_ms edges overrun decoded correlated rejected bursts frames usb_in usb_out usb_drops loops_per_sec
+ *		// gated_widths gated_periods sync_arms arena_failures stream_out stream_drops validated rejected_check
+ *
+ *	****** TRACE DUMP ******
+ *	0xA5 0x54 <version> <record count> <cycles per us> <records> <xor of record bytes>
+ *		// records are TraceRecord (trace.h), oldest first: uint32 cycles, uint8 event, uint8 arg8, uint16 arg16;
+ *		// USB433-Host-Tools/trace_decode.py renders a dump as a timeline
+ *
+ *	****** USB TEST STREAM ******
+ *	0 <n>\r\n <n bytes>
+ *		// byte i of the stream is (i % 251); the reply is followed by the pattern as fast as the IN
+ *		// endpoint drains. Other output is queued in between, so leave the device otherwise idle.
+ *		// USB433-Host-Tools/usb_throughput.py measures the rate and checks the pattern
+ *
+ *	****** SOF TIME SYNC ******
+ *	0 frame:<n> local_us:<us> us_per_frame:<16.16 fixed point> sofs:<n> calibrated:<0:1>
+ *		// every USB start of frame latches the 11 bit frame number with the local microsecond time;
+ *		// the local clock rate is measured against the frames to correct for drift. Received words
+ *		// carry local_us, the local time of their first rising edge, and sof:<frame>.<us>, the same
+ *		// instant on the host frame timeline (frame number mod 2048, microseconds into the frame), or
+ *		// sof:- without recent SOFs. Dongles on one host share that timeline, so their words can be
+ *		// ordered against each other.
+ *
+ *	****** STREAM INTERFACE ******
+ *		// a vendor specific interface (2) with one bulk IN endpoint (0x83), next to the CDC port.
+ *		// With "usb stream 1", reports are sent there in the same format as on the CDC port, so
+ *		// command responses on the CDC port aren't queued behind them. Reports are dropped
+ *		// (counted as stream_drops) while no host reads the endpoint.
  */
 void processUSB() {
+	PERF_SCOPE(PERF_PROCESS_USB);
+
 	// check for null receive buffer
 	if ((uint8_t) usb_rx_buffer[0] == 0) {
 		return;
@@ -188,8 +391,8 @@ void processUSB() {
         dispatch(usb_nodes, USB_COMMAND_COUNT, &ctx, 0);
     }
 
-    // transmit any error messages or feedback
-	CDC_Transmit_FS((uint8_t*) usb_tx_buffer, strlen(usb_tx_buffer));
+    // queue any error messages or feedback for transmit
+	CDC_Queue_FS((uint8_t*) usb_tx_buffer, strlen(usb_tx_buffer));
 
     // reset the command buffer
     memset(usb_rx_buffer, 0, sizeof(usb_rx_buffer));
@@ -198,10 +401,72 @@ void processUSB() {
     last_USB_time = HAL_GetTick();
 }
 
+/*
+ * Queue the contents of usb_tx_buffer to be sent to the USB host
+ */
 void pushUSB() {
-	HAL_GPIO_WritePin(USB_ACT_GPIO_Port, USB_ACT_Pin, GPIO_PIN_SET);
-	CDC_Transmit_FS((uint8_t*) usb_tx_buffer, strlen(usb_tx_buffer));
-	last_USB_time = HAL_GetTick();
+	CDC_Queue_FS((uint8_t*) usb_tx_buffer, strlen(usb_tx_buffer));
+}
+
+/*
+ * Queue an asynchronous report (received words, transmit status, raw samples,
+ * counters stream) to the stream interface if reports are routed there, else
+ * to the CDC port with the command responses. Returns the bytes queued.
+ */
+uint16_t queueReport(uint8_t* buf, uint16_t len) {
+	if (usb_stream_reports)
+		return Stream_Queue_FS(buf, len);
+	return CDC_Queue_FS(buf, len);
+}
+
+/*
+ * Queue the contents of usb_tx_buffer as an asynchronous report
+ */
+void pushReport() {
+	queueReport((uint8_t*) usb_tx_buffer, strlen(usb_tx_buffer));
+}
+
+/*
+ * Queue as much of the USB throughput test stream as fits in the IN queue it's
+ * routed to. Returns true while test bytes are still to be queued.
+ */
+bool fillUsbTest() {
+	uint8_t chunk[64];
+	while (usb_test_remaining) {
+		uint16_t len = (usb_test_remaining < sizeof(chunk)) ? usb_test_remaining : sizeof(chunk);
+		// wait for the endpoint to drain rather than count the queue as full
+		uint16_t space = usb_stream_reports ? STREAM_DATA_SIZE - 1 - Stream_Pending_FS()
+				: APP_TX_DATA_SIZE - 1 - CDC_Pending_FS();
+		if (space < len)
+			break;
+
+		for (uint16_t i = 0; i < len; i++) {
+			chunk[i] = usb_test_offset++ % 251;
+		}
+		queueReport(chunk, len);
+		usb_test_remaining -= len;
+	}
+	return usb_test_remaining != 0;
+}
+
+/*
+ * Check if the USB throughput test has bytes left to queue
+ */
+bool usbTestPending() {
+	return usb_test_remaining != 0;
+}
+
+/*
+ * Send the next run of queued data to the USB host once the endpoint is free
+ */
+void drainUSB() {
+	if (Stream_Drain_FS() == USBD_OK && Stream_Pending_FS() > 0) {
+		last_USB_time = HAL_GetTick();
+	}
+	if (CDC_Drain_FS() == USBD_OK && CDC_Pending_FS() > 0) {
+		HAL_GPIO_WritePin(USB_ACT_GPIO_Port, USB_ACT_Pin, GPIO_PIN_SET);
+		last_USB_time = HAL_GetTick();
+	}
 }
 
 /*
@@ -212,7 +477,7 @@ void handleLogic(CommandContext* ctx) {
 	if (ctx->remaining) { // value passed with call
 		uint8_t value = atoi(ctx->remaining); // parse argument
 		if (value > 1) { // invalid range of values
-			sprintf(usb_tx_buffer, "%u %u\r\n", USB_CC_BAD_VALUE, (unsigned int) value);
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
 			return;
 		}
 		if (isRx)
@@ -233,7 +498,7 @@ void handleSyncBit(CommandContext* ctx) {
 	if (ctx->remaining) {// value passed with call
 		uint32_t value = atoi(ctx->remaining); // parse argument
 		if (value > 1) {
-			sprintf(usb_tx_buffer, "%u %" PRIu32 "\r\n", USB_CC_BAD_VALUE, value);
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
 			return;
 		}
 		if (isRx)
@@ -252,7 +517,7 @@ void handleSyncBit(CommandContext* ctx) {
  */
 void handleStatus(CommandContext* ctx) {
 	if (ctx->remaining) { // value passed with call - illegal
-		sprintf(usb_tx_buffer, "%u %s\r\n", USB_CC_BAD_PARAM, ctx->remaining);
+		bufferCodeText(USB_CC_BAD_PARAM, ctx->remaining);
 		return;
 	}
 	bufferValueResponse(ctx, status);
@@ -264,11 +529,361 @@ void handleStatus(CommandContext* ctx) {
  */
 void handleVersion(CommandContext* ctx) {
 	if (ctx->remaining) { // value passed with call - illegal
-		sprintf(usb_tx_buffer, "%u %s\r\n", USB_CC_BAD_PARAM, ctx->remaining);
+		bufferCodeText(USB_CC_BAD_PARAM, ctx->remaining);
+		return;
+	}
+	bufferCodeText(USB_CC_OK, version);
+}
+
+/*
+ * Handle command "learn <uint8_t>"
+ */
+void handleLearn(CommandContext* ctx) {
+	uint8_t value = 0;
+	if (ctx->remaining) { // value passed with call
+		value = atoi(ctx->remaining); // parse argument
+		if (value >= TX_SLOTS) {
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
+			return;
+		}
+	} else {
+		// find the first empty slot
+		while (value < TX_SLOTS && tx.slots[value].valid)
+			value++;
+		if (value >= TX_SLOTS) {
+			bufferCode(USB_CC_BUSY);
+			return;
+		}
+	}
+	tx.learn_slot = value;
+	if (ctx->remaining)
+		bufferOk();
+	else
+		bufferValueResponse(ctx, value);
+}
+
+/*
+ * Handle command "sleep <0:1>"
+ */
+void handleSleep(CommandContext* ctx) {
+	if (ctx->remaining) { // value passed with call
+		uint8_t value = atoi(ctx->remaining); // parse argument
+		if (value > 1) {
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
+			return;
+		}
+		event_stats.sleep_enabled = (bool) value;
+		bufferOk();
+		return;
+	}
+	bufferValueResponse(ctx, event_stats.sleep_enabled);
+}
+
+/*
+ * Handle command "sleep latency <reset>"
+ */
+void handleSleepLatency(CommandContext* ctx) {
+	if (ctx->remaining) { // value passed with call
+		if (strcmp(ctx->remaining, "reset") != 0) {
+			bufferCodeText(USB_CC_BAD_PARAM, ctx->remaining);
+			return;
+		}
+		event_stats.wakes = 0;
+		event_stats.last_cycles = 0;
+		event_stats.max_cycles = 0;
+		bufferOk();
+		return;
+	}
+	Report report;
+	reportBegin(&report, usb_tx_buffer, sizeof(usb_tx_buffer));
+	reportU32(&report, USB_CC_OK);
+	reportField(&report, "last", event_stats.last_cycles);
+	reportField(&report, "max", event_stats.max_cycles);
+	reportField(&report, "wakes", event_stats.wakes);
+	reportEnd(&report);
+}
+
+/*
+ * Handle command "tasks <reset>"
+ */
+void handleTasks(CommandContext* ctx) {
+	if (ctx->remaining) { // value passed with call
+		if (strcmp(ctx->remaining, "reset") != 0) {
+			bufferCodeText(USB_CC_BAD_PARAM, ctx->remaining);
+			return;
+		}
+		resetTaskStats(tasks, task_count);
+		bufferOk();
+		return;
+	}
+
+	// one "name:runs/wcet/budget/overruns" field per task
+	Report report;
+	reportBegin(&report, usb_tx_buffer, sizeof(usb_tx_buffer));
+	reportU32(&report, USB_CC_OK);
+	for (uint8_t i = 0; i < task_count; i++) {
+		reportField(&report, tasks[i].name, tasks[i].runs);
+		reportChar(&report, '/');
+		reportU32(&report, tasks[i].wcet_cycles);
+		reportChar(&report, '/');
+		reportU32(&report, tasks[i].budget_cycles);
+		reportChar(&report, '/');
+		reportU32(&report, tasks[i].overruns);
+	}
+	reportEnd(&report);
+}
+
+/*
+ * Handle command "irq latency <reset>"
+ */
+void handleIrqLatency(CommandContext* ctx) {
+	if (ctx->remaining) { // value passed with call
+		if (strcmp(ctx->remaining, "reset") != 0) {
+			bufferCodeText(USB_CC_BAD_PARAM, ctx->remaining);
+			return;
+		}
+		latencyReset();
+		bufferOk();
+		return;
+	}
+
+	// one line per interrupt: count, max/mean ticks, and the histogram buckets
+	Report report;
+	reportBegin(&report, usb_tx_buffer, sizeof(usb_tx_buffer));
+	for (uint8_t i = 0; i < LATENCY_SOURCE_COUNT; i++) {
+		LatencyStats* stats = &latency_stats[i];
+		uint32_t mean = stats->count ? stats->sum_ticks / stats->count : 0;
+		reportU32(&report, USB_CC_OK);
+		reportChar(&report, ' ');
+		reportStr(&report, latency_names[i]);
+		reportField(&report, "n", stats->count);
+		reportField(&report, "max", stats->max_ticks);
+		reportField(&report, "mean", mean);
+		reportStr(&report, " hist:");
+		for (uint8_t b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+			if (b)
+				reportChar(&report, ',');
+			reportU32(&report, stats->hist[b]);
+		}
+		reportEnd(&report);
+	}
+}
+
+/*
+ * Handle command "irq priority <tim2:dma:usb> <0-15>"
+ */
+void handleIrqPriority(CommandContext* ctx) {
+	IRQn_Type irq = USB_LP_CAN1_RX0_IRQn;
+	if (strcmp(ctx->argv[ctx->arg_idx], "tim2") == 0)
+		irq = TIM2_IRQn;
+	else if (strcmp(ctx->argv[ctx->arg_idx], "dma") == 0)
+		irq = DMA1_Channel2_IRQn;
+
+	if (ctx->remaining) { // value passed with call
+		uint32_t value = atoi(ctx->remaining); // parse argument
+		if (value > 15) {
+			// only 4 priority bits are implemented
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
+			return;
+		}
+		HAL_NVIC_SetPriority(irq, value, 0);
+		bufferOk();
+		return;
+	}
+
+	uint32_t preempt, sub;
+	HAL_NVIC_GetPriority(irq, HAL_NVIC_GetPriorityGrouping(), &preempt, &sub);
+	bufferValueResponse(ctx, preempt);
+}
+
+/*
+ * Handle command "counters <reset>"
+ */
+void handleCounters(CommandContext* ctx) {
+	if (ctx->remaining) { // value passed with call
+		if (strcmp(ctx->remaining, "reset") != 0) {
+			bufferCodeText(USB_CC_BAD_PARAM, ctx->remaining);
+			return;
+		}
+		countersReset();
+		bufferOk();
+		return;
+	}
+
+	Report report;
+	reportBegin(&report, usb_tx_buffer, sizeof(usb_tx_buffer));
+	reportU32(&report, USB_CC_OK);
+	reportField(&report, "uptime_ms", HAL_GetTick());
+	reportField(&report, "edges", counters.edges);
+	reportField(&report, "overrun", counters.samples_overrun);
+	reportField(&report, "decoded", counters.words_decoded);
+	reportField(&report, "correlated", counters.words_correlated);
+	reportField(&report, "rejected", counters.words_rejected_len);
+	reportField(&report, "bursts", counters.tx_bursts);
+	reportField(&report, "frames", counters.tx_frames);
+	reportField(&report, "usb_in", counters.usb_bytes_in);
+	reportField(&report, "usb_out", counters.usb_bytes_out);
+	reportField(&report, "usb_drops", counters.usb_busy_drops);
+	reportField(&report, "loops_per_sec", counters.loops_per_sec);
+	reportField(&report, "gated_widths", counters.gated_widths);
+	reportField(&report, "gated_periods", counters.gated_periods);
+	reportField(&report, "sync_arms", counters.sync_arms);
+	reportField(&report, "arena_failures", counters.arena_failures);
+	reportField(&report, "arena_free", arenaFreeBlocks());
+	reportField(&report, "stream_out", counters.stream_bytes_out);
+	reportField(&report, "stream_drops", counters.stream_drops);
+	reportField(&report, "validated", counters.words_validated);
+	reportField(&report, "rejected_check", counters.words_rejected_check);
+	reportEnd(&report);
+}
+
+/*
+ * Handle command "counters binary"
+ */
+void handleCountersBinary(CommandContext* ctx) {
+	// the frame holds zero bytes, so it's queued directly rather than through usb_tx_buffer
+	uint8_t frame[COUNTERS_FRAME_SIZE];
+	uint16_t len = countersFrame(frame);
+	if (!CDC_Queue_FS(frame, len)) {
+		// the queue is full; CDC_Queue_FS counted the drop in usb_busy_drops
+		bufferCode(USB_CC_BUSY);
+	}
+}
+
+/*
+ * Handle command "counters stream <uint32_t>"
+ */
+void handleCountersStream(CommandContext* ctx) {
+	if (ctx->remaining) { // value passed with call
+		counters_stream_ms = atoi(ctx->remaining);
+		bufferOk();
+		return;
+	}
+	bufferValueResponse(ctx, counters_stream_ms);
+}
+
+/*
+ * Handle command "usb test"
+ */
+void handleUsbTest(CommandContext* ctx) {
+	if (ctx->remaining) { // value passed with call
+		if (usb_test_remaining) {
+			bufferCode(USB_CC_BUSY);
+			return;
+		}
+		usb_test_remaining = strtoul(ctx->remaining, 0, 10);
+		usb_test_offset = 0;
+		bufferCodeValue(USB_CC_OK, usb_test_remaining);
+		return;
+	}
+	bufferValueResponse(ctx, usb_test_remaining);
+}
+
+/*
+ * Handle command "usb stream"
+ */
+void handleUsbStream(CommandContext* ctx) {
+	if (ctx->remaining) { // value passed with call
+		if (usb_test_remaining) {
+			bufferCode(USB_CC_BUSY);
+			return;
+		}
+		usb_stream_reports = atoi(ctx->remaining) != 0;
+		bufferOk();
+		return;
+	}
+	bufferValueResponse(ctx, usb_stream_reports);
+}
+
+/*
+ * Handle command "usb sof"
+ */
+void handleUsbSof(CommandContext* ctx) {
+	TimeSync latch;
+	timesyncLatch(&latch);
+
+	Report report;
+	reportBegin(&report, usb_tx_buffer, sizeof(usb_tx_buffer));
+	reportU32(&report, USB_CC_OK);
+	reportField(&report, "frame", latch.frame);
+	reportField(&report, "local_us", latch.local_us);
+	reportField(&report, "us_per_frame", latch.us_per_frame_q16);
+	reportField(&report, "sofs", latch.sofs);
+	reportField(&report, "calibrated", latch.calibrated);
+	reportEnd(&report);
+}
+
+/*
+ * Handle command "trace dump"
+ */
+void handleTraceDump(CommandContext* ctx) {
+	// the dump holds zero bytes, so it's queued directly and usb_tx_buffer left empty
+	uint16_t len = traceDump((uint8_t*) usb_tx_buffer, sizeof(usb_tx_buffer));
+	if (!len || !CDC_Queue_FS((uint8_t*) usb_tx_buffer, len)) {
+		bufferCode(USB_CC_BUSY);
+		return;
+	}
+	usb_tx_buffer[0] = 0;
+}
+
+/*
+ * Handle command "trace clear"
+ */
+void handleTraceClear(CommandContext* ctx) {
+	traceClear();
+	bufferOk();
+}
+
+/*
+ * Handle command "trace enable <uint32_t>"
+ */
+void handleTraceEnable(CommandContext* ctx) {
+	if (ctx->remaining) { // value passed with call
+		trace_mask = strtoul(ctx->remaining, 0, 0);
+		bufferOk();
+		return;
+	}
+	bufferValueResponse(ctx, trace_mask);
+}
+
+#ifdef PERF_ENABLED
+/*
+ * Handle command "perf <reset>"
+ */
+void handlePerf(CommandContext* ctx) {
+	if (ctx->remaining) { // value passed with call
+		if (strcmp(ctx->remaining, "reset") != 0) {
+			bufferCodeText(USB_CC_BAD_PARAM, ctx->remaining);
+			return;
+		}
+		perfReset();
+		bufferOk();
 		return;
 	}
-	sprintf(usb_tx_buffer, "%u %s\r\n", USB_CC_OK, version);
+
+	// one line per region: count, min/max/mean cycles, and the histogram buckets
+	Report report;
+	reportBegin(&report, usb_tx_buffer, sizeof(usb_tx_buffer));
+	for (uint8_t i = 0; i < PERF_REGION_COUNT; i++) {
+		PerfStats* stats = &perf_stats[i];
+		uint32_t mean = stats->count ? (uint32_t) (stats->sum_cycles / stats->count) : 0;
+		reportU32(&report, USB_CC_OK);
+		reportChar(&report, ' ');
+		reportStr(&report, perf_names[i]);
+		reportField(&report, "n", stats->count);
+		reportField(&report, "min", stats->min_cycles);
+		reportField(&report, "max", stats->max_cycles);
+		reportField(&report, "mean", mean);
+		reportStr(&report, " hist:");
+		for (uint8_t b = 0; b < PERF_HIST_BUCKETS; b++) {
+			if (b)
+				reportChar(&report, ',');
+			reportU32(&report, stats->hist[b]);
+		}
+		reportEnd(&report);
+	}
 }
+#endif
 
 /*
  * Handle command "rx mode <0:1:2>"
@@ -278,7 +893,7 @@ void handleRxMode(CommandContext* ctx) {
 	if (ctx->remaining) {// value passed with call
 		uint8_t value = atoi(ctx->remaining); // parse argument
 		if (value > 2) { // invalid range of values
-			sprintf(usb_tx_buffer, "%u %" PRIu8 "\r\n", USB_CC_BAD_VALUE, value);
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
 			return;
 		}
 		rx.mode = value;
@@ -296,10 +911,10 @@ void handleRxMode(CommandContext* ctx) {
 void handleRxTimeout(CommandContext* ctx) {
 	if (ctx->remaining) {// value passed with call
 		uint32_t value = atoi(ctx->remaining); // parse argument
-		if (value > 5e6 || value < rx.bit_max_period) {
+		if (value > 5000000 || value < rx.bit_max_period) {
 			// invalid range of values... 5 seconds not realistic for data rx
 			// also any shorter than the maximum bit period means data blends together
-			sprintf(usb_tx_buffer, "%u %" PRIu32 "\r\n", USB_CC_BAD_VALUE, value);
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
 			return;
 		}
 		rx.correl.timeout_us = value;
@@ -314,7 +929,12 @@ void handleRxTimeout(CommandContext* ctx) {
  */
 void handleBitPeriod(CommandContext* ctx) {
 	if (ctx->remaining) { // value passed with call
-		uint32_t value = atoi(ctx->remaining); // parse argument
+		uint32_t value = strtoul(ctx->remaining, 0, 10); // parse argument
+		if (value > TICKS_MAX_US) {
+			// the timeout is compared in capture ticks
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
+			return;
+		}
 		rx.bit_max_period = value;
 		bufferOk();
 		return;
@@ -330,7 +950,7 @@ void handleRxMatchCount(CommandContext* ctx) {
 		uint8_t value = atoi(ctx->remaining); // parse argument
 		if (value > RX_CORREL_WORDS) {
 			// wouldn't be able to buffer enough matches
-			sprintf(usb_tx_buffer, "%u %u\r\n", USB_CC_BAD_VALUE, (unsigned int) value);
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
 			return;
 		}
 		rx.correl.match_thresh = value;
@@ -348,7 +968,7 @@ void handleRxMinLength(CommandContext* ctx) {
 		uint8_t value = atoi(ctx->remaining); // parse argument
 		if (value > RX_MAX_BITS || value > rx.correl.max_word_len) {
 			// not enough space in the word buffer
-			sprintf(usb_tx_buffer, "%u %u\r\n", USB_CC_BAD_VALUE, (unsigned int) value);
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
 			return;
 		}
 		rx.correl.min_word_len = value;
@@ -366,7 +986,7 @@ void handleRxMaxLength(CommandContext* ctx) {
 		uint8_t value = atoi(ctx->remaining); // parse argument
 		if (value > RX_MAX_BITS || value < rx.correl.min_word_len) {
 			// not enough space in the word buffer
-			sprintf(usb_tx_buffer, "%u %u\r\n", USB_CC_BAD_VALUE, (unsigned int) value);
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
 			return;
 		}
 		rx.correl.max_word_len = value;
@@ -376,19 +996,303 @@ void handleRxMaxLength(CommandContext* ctx) {
 	bufferValueResponse(ctx, rx.correl.max_word_len);
 }
 
+/*
+ * Handle command "rx word hamming"
+ */
+void handleRxHamming(CommandContext* ctx) {
+	if (ctx->remaining) {// value passed with call
+		uint8_t value = atoi(ctx->remaining); // parse argument
+		if (value > RX_HAMMING_MAX) {
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
+			return;
+		}
+		rx.correl.hamming = value;
+		bufferOk();
+		return;
+	}
+	bufferValueResponse(ctx, rx.correl.hamming);
+}
+
+/*
+ * Handle command "rx filter <0-15>"
+ */
+void handleRxFilter(CommandContext* ctx) {
+	if (ctx->remaining) {// value passed with call
+		uint8_t value = atoi(ctx->remaining); // parse argument
+		if (value > RX_FILTER_MAX) {
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
+			return;
+		}
+		setRxFilter(value);
+		bufferOk();
+		return;
+	}
+	bufferValueResponse(ctx, rx.ic_filter);
+}
+
+/*
+ * Handle command "rx gate <width:period> <uint16_t>"
+ */
+void handleRxGate(CommandContext* ctx) {
+	uint16_t* gate = (strcmp(ctx->argv[ctx->arg_idx], "width") == 0) ? &rx.min_width_us : &rx.min_period_us;
+	if (ctx->remaining) {// value passed with call
+		uint32_t value = atoi(ctx->remaining); // parse argument
+		if (value > UINT16_MAX) {
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
+			return;
+		}
+		*gate = value;
+		bufferOk();
+		return;
+	}
+	bufferValueResponse(ctx, *gate);
+}
+
+/*
+ * Handle command "rx sync <0:1>"
+ */
+void handleRxSync(CommandContext* ctx) {
+	if (ctx->remaining) {// value passed with call
+		uint8_t value = atoi(ctx->remaining); // parse argument
+		if (value > 1) {
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
+			return;
+		}
+		rx.sync = (bool) value;
+		bufferOk();
+		return;
+	}
+	bufferValueResponse(ctx, rx.sync);
+}
+
+/*
+ * Handle command "rx sync gap <uint32_t>"
+ */
+void handleRxSyncGap(CommandContext* ctx) {
+	if (ctx->remaining) {// value passed with call
+		uint32_t value = strtoul(ctx->remaining, 0, 10); // parse argument
+		if (value > TICKS_MAX_US) {
+			// the gap is compared in capture ticks
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
+			return;
+		}
+		rx.sync_gap_us = value;
+		bufferOk();
+		return;
+	}
+	bufferValueResponse(ctx, rx.sync_gap_us);
+}
+
+/*
+ * Handle command "rx sync high <uint16_t>"
+ */
+void handleRxSyncHigh(CommandContext* ctx) {
+	if (ctx->remaining) {// value passed with call
+		uint32_t value = atoi(ctx->remaining); // parse argument
+		if (value > UINT16_MAX) {
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
+			return;
+		}
+		rx.sync_high_us = value;
+		bufferOk();
+		return;
+	}
+	bufferValueResponse(ctx, rx.sync_high_us);
+}
+
+/*
+ * Handle command "rx check <0-3> [off | <crc:xor:sum:lfsr> <len> <width> [poly] [init]]"
+ */
+void handleRxCheck(CommandContext* ctx) {
+	if (!ctx->remaining) {// no value passed with call
+		bufferCode(USB_CC_MISSING_PARAM);
+		return;
+	}
+
+	uint8_t index = atoi(ctx->remaining); // parse argument
+	if (index >= RX_VALIDATORS) {
+		bufferCodeValue(USB_CC_BAD_VALUE, index);
+		return;
+	}
+	RxValidator* validator = &validators[index];
+
+	int arg = ctx->arg_idx + 2; // first argument after the index
+	if (arg >= ctx->argc) {
+		Report report;
+		reportBegin(&report, usb_tx_buffer, sizeof(usb_tx_buffer));
+		reportU32(&report, USB_CC_OK);
+		reportChar(&report, ' ');
+		reportStr(&report, validator_names[validator->type]);
+		reportField(&report, "len", validator->len);
+		reportField(&report, "width", validator->width);
+		// as many hex digits as the check field is wide
+		uint8_t digits = (validator->width + 3) / 4;
+		reportStr(&report, " poly:0x");
+		reportHex(&report, validator->poly, digits);
+		reportStr(&report, " init:0x");
+		reportHex(&report, validator->init, digits);
+		reportEnd(&report);
+		return;
+	}
+
+	uint8_t type = VALIDATE_TYPES;
+	for (uint8_t i = 0; i < VALIDATE_TYPES; i++) {
+		if (strcmp(ctx->argv[arg], validator_names[i]) == 0)
+			type = i;
+	}
+	if (type == VALIDATE_TYPES) {
+		bufferCodeText(USB_CC_BAD_PARAM, ctx->argv[arg]);
+		return;
+	}
+	if (type == VALIDATE_OFF) {
+		validator->type = VALIDATE_OFF;
+		bufferOk();
+		return;
+	}
+	if (arg + 2 >= ctx->argc) {
+		bufferCode(USB_CC_MISSING_PARAM);
+		return;
+	}
+
+	uint32_t len = atoi(ctx->argv[arg + 1]);
+	uint32_t width = atoi(ctx->argv[arg + 2]);
+	uint32_t poly = (arg + 3 < ctx->argc) ? strtoul(ctx->argv[arg + 3], 0, 0) : 0;
+	uint32_t init = (arg + 4 < ctx->argc) ? strtoul(ctx->argv[arg + 4], 0, 0) : 0;
+	if (width < 1 || width > 32) {
+		bufferCodeValue(USB_CC_BAD_VALUE, width);
+		return;
+	}
+	if (len <= width || len > RX_MAX_BITS + 1) {
+		// no data in front of the check field, or longer than any received word
+		bufferCodeValue(USB_CC_BAD_VALUE, len);
+		return;
+	}
+	if ((type == VALIDATE_CRC || type == VALIDATE_LFSR) && !poly) {
+		bufferCode(USB_CC_MISSING_PARAM);
+		return;
+	}
+
+	validator->type = type;
+	validator->len = len;
+	validator->width = width;
+	validator->poly = poly;
+	validator->init = init;
+	bufferOk();
+}
+
+/*
+ * Handle command "rx adaptive <0:1>"
+ */
+void handleRxAdaptive(CommandContext* ctx) {
+	if (ctx->remaining) {// value passed with call
+		uint8_t value = atoi(ctx->remaining); // parse argument
+		if (value > 1) {
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
+			return;
+		}
+		if (rx.adaptive && !value) {
+			// forget learned timings so re-enabling starts from fresh estimates
+			for (uint8_t i = 0; i < RX_LEARN_SOURCES; i++)
+				rx.sources[i].hits = 0;
+		}
+		rx.adaptive = (bool) value;
+		bufferOk();
+		return;
+	}
+	bufferValueResponse(ctx, rx.adaptive);
+}
+
+/*
+ * Handle command "rx inject <p,w,p,w,...>"
+ */
+void handleRxInject(CommandContext* ctx) {
+	if (!ctx->remaining) {
+		bufferCode(USB_CC_MISSING_PARAM);
+		return;
+	}
+	if (isTxActive() || rx.blind) {
+		// the capture interrupt clears the current sample slot while the
+		//   receiver is blind for a burst; drop any chunk staged so far
+		injectRxEnd(false);
+		bufferCode(USB_CC_BUSY);
+		return;
+	}
+	if (!rxInjectReady()) {
+		// the radio is on or the decoder is still busy with earlier samples
+		bufferCode(USB_CC_BUSY);
+		return;
+	}
+
+	uint16_t count = 0;
+	bool malformed = false;
+	char* idx = ctx->remaining;
+	while (*idx) {
+		uint32_t period = strtoul(idx, &idx, 10);
+		if (*idx != ',') {
+			// a period without its width, or a bad character
+			malformed = true;
+			break;
+		}
+		idx++;
+		uint32_t width = strtoul(idx, &idx, 10);
+		if (!period || !width || width > period || !injectRxSample(period, width)) {
+			malformed = true;
+			break;
+		}
+		count++;
+		if (*idx == ',') idx++;
+	}
+
+	if (malformed) {
+		// drop the whole chunk; report how many samples were taken before the bad one
+		injectRxEnd(false);
+		bufferCodeValue(USB_CC_BAD_VALUE, count);
+		return;
+	}
+	// a trailing comma continues the chunk in the next command
+	if (idx[-1] != ',') {
+		injectRxEnd(true);
+	}
+	// the samples aren't echoed back; they can fill the whole command buffer
+	bufferCodeValue(USB_CC_OK, count);
+}
+
+/*
+ * Handle command "rx raw <0:1>"
+ */
+void handleRxRaw(CommandContext* ctx) {
+	if (ctx->remaining) {// value passed with call
+		uint8_t value = atoi(ctx->remaining); // parse argument
+		if (value > 1) {
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
+			return;
+		}
+		rx.raw = (bool) value;
+		bufferOk();
+		return;
+	}
+	bufferValueResponse(ctx, rx.raw);
+}
+
 /*
  * Handle command "tx time long <uint16_t>"
  */
 void handleTxLong(CommandContext* ctx) {
 	if (ctx->remaining) {// value passed with call
 		uint32_t value = atoi(ctx->remaining); // parse argument
-		if (value > (UINT16_MAX >> 2) || value < tx.t_short) {
+		if (value > TX_MAX_PULSE_US || value < tx.t_short) {
 			// not enough space in the word buffer
-			sprintf(usb_tx_buffer, "%u %" PRIu32 "\r\n", USB_CC_BAD_VALUE, value);
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
 			return;
 		}
+		uint16_t previous = tx.t_long;
 		tx.t_long = (uint16_t) value;
-		updateARR(&tx);
+		if (!updateARR(&tx)) {
+			// the bit period doesn't fit the 16 bit TIM1 count
+			tx.t_long = previous;
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
+			return;
+		}
 		bufferOk();
 		return;
 	}
@@ -401,13 +1305,19 @@ void handleTxLong(CommandContext* ctx) {
 void handleTxShort(CommandContext* ctx) {
 	if (ctx->remaining) {// value passed with call
 		uint32_t value = atoi(ctx->remaining); // parse argument
-		if (value > (UINT16_MAX >> 2) || value > tx.t_long) {
+		if (value > TX_MAX_PULSE_US || value > tx.t_long) {
 			// not enough space in the word buffer
-			sprintf(usb_tx_buffer, "%u %" PRIu32 "\r\n", USB_CC_BAD_VALUE, value);
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
 			return;
 		}
+		uint16_t previous = tx.t_short;
 		tx.t_short = (uint16_t) value;
-		updateARR(&tx);
+		if (!updateARR(&tx)) {
+			// the bit period doesn't fit the 16 bit TIM1 count
+			tx.t_short = previous;
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
+			return;
+		}
 		bufferOk();
 		return;
 	}
@@ -423,7 +1333,7 @@ void handleTxFrameDelay(CommandContext* ctx) {
 		if (value > 50*(tx.t_short + tx.t_long) || value < (tx.t_short + tx.t_long)) {
 			// absurdly long delay between frames. Typically it's about 6-8 * t_long
 			// constrained to > 1*period; < 50*period
-			sprintf(usb_tx_buffer, "%u %" PRIu32 "\r\n", USB_CC_BAD_VALUE, value);
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
 			return;
 		}
 		tx.frame_delay_us = value;
@@ -439,10 +1349,10 @@ void handleTxFrameDelay(CommandContext* ctx) {
 void handleTxBurstDelay(CommandContext* ctx) {
 	if (ctx->remaining) {// value passed with call
 		uint32_t value = atoi(ctx->remaining); // parse argument
-		if (value > 60e6 || value < (tx.t_long + tx.t_short)) {
+		if (value > 60000000 || value < (tx.t_long + tx.t_short)) {
 			// could do up to 60 seconds between transmissions... but that's absurd
 			// can't be less than the frame delay
-			sprintf(usb_tx_buffer, "%u %" PRIu32 "\r\n", USB_CC_BAD_VALUE, value);
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
 			return;
 		}
 		tx.burst_delay_us = value;
@@ -460,7 +1370,7 @@ void handleTxRepeat(CommandContext* ctx) {
 		uint32_t value = atoi(ctx->remaining); // parse argument
 		if (value > 100) {
 			// why would you need to repeat more than 100 times??
-			sprintf(usb_tx_buffer, "%u %" PRIu32 "\r\n", USB_CC_BAD_VALUE, value);
+			bufferCodeValue(USB_CC_BAD_VALUE, value);
 			return;
 		}
 		tx.frame_repeat = (uint8_t) value;
@@ -485,19 +1395,19 @@ void handleTxRepeat(CommandContext* ctx) {
 void handleTxWord(CommandContext* ctx) {
 	if (!ctx->remaining) {// no value passed with call
 		// we're missing a parameter
-		sprintf(usb_tx_buffer, "%u\r\n", USB_CC_MISSING_PARAM);
+		bufferCode(USB_CC_MISSING_PARAM);
 		return;
 	}
 
 	// check for valid word length
 	if (strlen(ctx->remaining) > TX_MAX_BITS + (tx.ignore_sync_bit ? 1 : 0)) {
-		sprintf(usb_tx_buffer, "%u %s\r\n", USB_CC_BAD_VALUE, ctx->remaining);
+		bufferCodeText(USB_CC_BAD_VALUE, ctx->remaining);
 		return;
 	}
 
 	// check if the tx buffer has data in the last index already; if so, return busy error
-	if (tx.buffer[TX_BUFFER_LEN - 1][0] != 0) {
-		sprintf(usb_tx_buffer, "%u\r\n", USB_CC_BUSY);
+	if (tx.buffer[TX_BUFFER_LEN - 1]) {
+		bufferCode(USB_CC_BUSY);
 		return;
 	}
 
@@ -505,40 +1415,110 @@ void handleTxWord(CommandContext* ctx) {
 	for(unsigned int i = 0; i < strlen(ctx->remaining); i++) {
 		if (ctx->remaining[i] != '1' && ctx->remaining[i] != '0') {
 			// invalid character
-			sprintf(usb_tx_buffer, "%u %s\r\n", USB_CC_BAD_VALUE, ctx->remaining);
+			bufferCodeText(USB_CC_BAD_VALUE, ctx->remaining);
 			return;
 		}
 	}
 
 	// find the next available index and insert data there
 	for (unsigned int i = 0; i < TX_BUFFER_LEN; i++) {
-		if (tx.buffer[i][0] == 0) {
+		if (!tx.buffer[i]) {
 			// nothing is queued yet, and data is valid, so push it to the txData buffer
+			tx.buffer[i] = arenaAlloc(strlen(ctx->remaining) + 2);
+			if (!tx.buffer[i]) {
+				counters.arena_failures++;
+				bufferCode(USB_CC_BUSY);
+				return;
+			}
 			// add leading '0' as the TX start bit
-			sprintf(tx.buffer[i], "%s%s", tx.ignore_sync_bit ? "" : (tx.invert_logic ? "1" : "0"), ctx->remaining);
+			char* word = tx.buffer[i];
+			if (!tx.ignore_sync_bit)
+				*word++ = tx.invert_logic ? '1' : '0';
+			strcpy(word, ctx->remaining);
+			tx.buffer_slot[i] = 0;
 			bufferOk();
 			return;
 		}
 	}
 }
 
+/*
+ * Handle command "tx slot <uint8_t>"
+ */
+void handleTxSlot(CommandContext* ctx) {
+	if (!ctx->remaining) {// no value passed with call
+		bufferCode(USB_CC_MISSING_PARAM);
+		return;
+	}
+
+	uint8_t value = atoi(ctx->remaining); // parse argument
+	if (value >= TX_SLOTS || !tx.slots[value].valid) {
+		// nothing learned to this slot
+		bufferCodeValue(USB_CC_BAD_VALUE, value);
+		return;
+	}
+
+	if (!queueTxSlot(&tx, value)) {
+		// tx buffer is full
+		bufferCode(USB_CC_BUSY);
+		return;
+	}
+	bufferOk();
+}
+
 /*
  * Response for getting generic values
  */
 void bufferValueResponse(CommandContext* ctx, long responseValue) {
-	char* idx = usb_tx_buffer;
-	sprintf(usb_tx_buffer, "%u ", USB_CC_OK);
-	idx += strlen(usb_tx_buffer);
+	Report report;
+	reportBegin(&report, usb_tx_buffer, sizeof(usb_tx_buffer));
+	reportU32(&report, USB_CC_OK);
 	for (uint8_t argi = 1; argi < ctx->argc; argi++) {
-		sprintf(idx, "%s ", ctx->argv[argi]);
-		idx += strlen(ctx->argv[argi]) + 1;
+		reportChar(&report, ' ');
+		reportStr(&report, ctx->argv[argi]);
 	}
-	sprintf(idx, "%" PRId32 "\r\n", responseValue);
+	reportChar(&report, ' ');
+	reportI32(&report, responseValue);
+	reportEnd(&report);
 }
 
 /*
  * Response for an "OK" to the USB host
  */
 void bufferOk() {
-	sprintf(usb_tx_buffer, "%u OK\r\n", USB_CC_OK);
+	bufferCodeText(USB_CC_OK, "OK");
+}
+
+/*
+ * Response of a bare completion code
+ */
+void bufferCode(uint8_t code) {
+	Report report;
+	reportBegin(&report, usb_tx_buffer, sizeof(usb_tx_buffer));
+	reportU32(&report, code);
+	reportEnd(&report);
+}
+
+/*
+ * Response of a completion code and a text, e.g. the offending parameter
+ */
+void bufferCodeText(uint8_t code, const char* text) {
+	Report report;
+	reportBegin(&report, usb_tx_buffer, sizeof(usb_tx_buffer));
+	reportU32(&report, code);
+	reportChar(&report, ' ');
+	reportStr(&report, text);
+	reportEnd(&report);
+}
+
+/*
+ * Response of a completion code and a value, e.g. the rejected value
+ */
+void bufferCodeValue(uint8_t code, uint32_t value) {
+	Report report;
+	reportBegin(&report, usb_tx_buffer, sizeof(usb_tx_buffer));
+	reportU32(&report, code);
+	reportChar(&report, ' ');
+	reportU32(&report, value);
+	reportEnd(&report);
 }
@@ -7,17 +7,23 @@
 #include "stm32f1xx_hal.h"
 #include "stm32f1xx_hal_tim.h"
 #include "usbd_cdc_if.h"
+#include "usbd_stream_if.h"
 
-#include "stdio.h"
 #include "stdint.h"
 #include "string.h"
-#include "inttypes.h"
 
 #include "main.h"
 #include "core_main.h"
 #include "commands.h"
 #include "transmitter.h"
 #include "receiver.h"
+#include "events.h"
+#include "scheduler.h"
+#include "counters.h"
+#include "timesync.h"
+#include "arena.h"
+#include "report.h"
+#include "perf.h"
 
 // errors and system status flags
 // This status is sectioned into 4 bytes:
@@ -40,6 +46,7 @@ uint16_t timeout_ms = 250;
 // =================== SYS PARAMS =======================
 
 int USER_setup(void) {
+	eventsInit(); // start cycle counter for event latency
 	txInit(&tx); // initialize Tx function
 	rxInit(&rx); // initialize Rx function
 
@@ -54,77 +61,204 @@ int USER_setup(void) {
 	return 0;
 }
 
+// ================= TASKS ======================
+
 /*
- * User-defined loop structure. There are 3 loop return conditions:
- * return 0: loop should continue
- * return >0: loop should terminate, no error handling; program will execute USER_shutdown
- * return <0: loop should terminate, errors to report; program will execute USER_Error
+ * Start the next frame or burst of a transmission
  */
-int USER_loop(void) {
-	// process any potential USB data received
-	processUSB();
+static bool txReady(uint32_t events) {
+	// only needed while a burst is running or words are queued
+	//   (delays are timed by the 1 ms tick wake)
+	return (events & EVT_TX_FRAME) || !data.burst_complete || tx.buffer[0];
+}
 
-	// process updates to current / next transmission
+static bool txRun(void) {
 	processTx(&tx, &data);
+	return false;
+}
+
+/*
+ * Send queued responses and reports to the USB host
+ */
+static bool usbInReady(uint32_t events) {
+	// a busy endpoint chains the next transfer itself from the IN complete interrupt
+	return (CDC_Pending_FS() > 0 && !CDC_Busy_FS()) || (Stream_Pending_FS() > 0 && !Stream_Busy_FS())
+			|| usbTestPending();
+}
+
+static bool usbInRun(void) {
+	fillUsbTest();
+	drainUSB();
+	return false;
+}
+
+/*
+ * Decode a slice of the RF received buffer content
+ */
+static bool decoderReady(uint32_t events) {
+	// unprocessed samples also need polling for the end-of-word timeout
+	return (events & EVT_RX_EDGE) || rx.stor_idx != rx.tgt_idx || rx.proc_idx != rx.tgt_idx;
+}
+
+static bool decoderRun(void) {
+	return checkRxBuffers();
+}
+
+/*
+ * Parse and execute a command from the USB host
+ */
+static bool commandReady(uint32_t events) {
+	return events & EVT_USB_RX;
+}
+
+static bool commandRun(void) {
+	processUSB();
+	return false;
+}
+
+/*
+ * Append the report line of a correlated word, with the timings averaged over
+ * its matches in 'stat_packet'
+ */
+static void reportRxWord(Report* report, RxPacket* stat_packet) {
+	PERF_SCOPE(PERF_RX_REPORT);
+	RxPacket* match = rx.correl.last_match;
+
+	reportU32(report, status & (RX_WORD_AVAILABLE << 16));
+	reportStr(report, " word:");
+	reportStr(report, stat_packet->word);
+	reportField(report, "len", match->len);
+	reportField(report, "long_us", TICKS_TO_US(stat_packet->long_ticks));
+	reportField(report, "short_us", TICKS_TO_US(stat_packet->short_ticks));
+	reportField(report, "period_us", TICKS_TO_US(stat_packet->period_ticks));
+	reportField(report, "logic", match->logic);
+	reportField(report, "ignoresync", rx.ignore_sync_bit);
+
+	// date the word by its first occurrence, in local time and on the host frame timeline
+	uint16_t frame, frame_us;
+	reportField(report, "local_us", match->time_us);
+	if (timesyncMap(match->time_us, &frame, &frame_us)) {
+		reportField(report, "sof", frame);
+		reportChar(report, '.');
+		reportU32Pad(report, frame_us, 3);
+	} else {
+		reportStr(report, " sof:-");
+	}
+	reportEnd(report);
+}
 
+/*
+ * Report transmitter and receiver status changes, stream the counters, and
+ * time out the USB LED
+ */
+static bool housekeepingReady(uint32_t events) {
+	return ((status >> 8) & 0xFF) > TX_BUFFER_EMPTY || ((status >> 16) & 0xFF) || countersStreamDue()
+			|| HAL_GPIO_ReadPin(USB_ACT_GPIO_Port, USB_ACT_Pin) == GPIO_PIN_SET;
+}
+
+static bool housekeepingRun(void) {
 	// handle system feedback due to transmit status values
 	if (((status >> 8) & 0xFF) > TX_BUFFER_EMPTY) {
-		memset(usb_tx_buffer, 0, sizeof(usb_tx_buffer));
+		Report report;
+		reportBegin(&report, usb_tx_buffer, sizeof(usb_tx_buffer));
 		// buffer outputs to usb host on tx buffer prep fail or tx complete flags
 		if ((status >> 8) & TX_PREP_FAILED) {
-			sprintf(usb_tx_buffer, "%" PRIu32 " %s\r\n", status & (TX_PREP_FAILED << 8), tx.buffer[0]);
+			reportU32(&report, status & (TX_PREP_FAILED << 8));
+			reportChar(&report, ' ');
+			reportStr(&report, tx.buffer[0]);
+			reportEnd(&report);
 		} else if ((status >> 8) & TX_COMPLETE) {
-			sprintf(usb_tx_buffer, "%" PRIu32 " %s\r\n", status & (TX_COMPLETE << 8), tx.buffer[0]);
+			reportU32(&report, status & (TX_COMPLETE << 8));
+			reportChar(&report, ' ');
+			reportStr(&report, tx.buffer[0]);
+			reportField(&report, "blind_start_us", data.blind_start_us);
+			reportField(&report, "blind_us", data.blind_us);
+			reportEnd(&report);
 		}
 
 		// tx buffer retains tx data until either a fail to buffer or a transmission complete
 		// Once either of those conditions are met, shift the buffer over.
 		if ((status >> 8) & (TX_PREP_FAILED | TX_COMPLETE)) {
 			// shift the tx_buffer to the left
-			memmove(tx.buffer, tx.buffer[1], (TX_BUFFER_LEN - 1) * TX_MAX_BITS);
-			memset(tx.buffer[TX_BUFFER_LEN - 1], 0, TX_MAX_BITS);
+			arenaFree(tx.buffer[0]);
+			memmove(tx.buffer, &tx.buffer[1], (TX_BUFFER_LEN - 1) * sizeof(tx.buffer[0]));
+			tx.buffer[TX_BUFFER_LEN - 1] = 0;
+			memmove(tx.buffer_slot, &tx.buffer_slot[1], TX_BUFFER_LEN - 1);
+			tx.buffer_slot[TX_BUFFER_LEN - 1] = 0;
 			status &= ~((TX_PREP_FAILED | TX_COMPLETE) << 8); // clear the flags
 		}
-		pushUSB();
+		pushReport();
 	}
 
-	// process RF received buffer content
-	checkRxBuffers();
-
-	// TODO: check for matching received words, and calculate average of observed timings
-
 	// check if the receiver status is non-zero
 	if ((status >> 16) & 0xFF) {
-		memset(usb_tx_buffer, 0, sizeof(usb_tx_buffer));
+		Report report;
+		reportBegin(&report, usb_tx_buffer, sizeof(usb_tx_buffer));
 		// data received, so transmit to USB host
 		if ((status >> 16) & RX_WORD_AVAILABLE) {
 
 			// statistically calculate the timings based on average of match timings
 			RxPacket stat_packet;
-			memset(stat_packet.word, 0, sizeof(stat_packet.word)); // clear to zero
-			memcpy(stat_packet.word, rx.correl.last_match->word, strlen(rx.correl.last_match->word)); // copy match string
+			stat_packet.word = rx.correl.last_match->word; // borrowed from the correlation buffer; not freed
 
 			uint8_t matches = 0;
-			for (uint8_t i = 0; i < rx.correl.index; i++) {
+			for (uint8_t i = 0; i < RX_CORREL_WORDS; i++) {
 				// ignore non-matches
-				if (strcmp(stat_packet.word, rx.correl.received[i].word) != 0) {
+				if (!isCorrelRepeat(&rx.correl, i)) {
 					continue;
 				}
 
-				stat_packet.long_us = (stat_packet.long_us * matches + rx.correl.received[i].long_us) / (matches + 1);
-				stat_packet.short_us = (stat_packet.short_us * matches + rx.correl.received[i].short_us) / (matches + 1);
-				stat_packet.period_us = (stat_packet.period_us * matches + rx.correl.received[i].period_us) / (matches + 1);
+				stat_packet.long_ticks = (stat_packet.long_ticks * matches + rx.correl.received[i].long_ticks) / (matches + 1);
+				stat_packet.short_ticks = (stat_packet.short_ticks * matches + rx.correl.received[i].short_ticks) / (matches + 1);
+				stat_packet.period_ticks = (stat_packet.period_ticks * matches + rx.correl.received[i].period_ticks) / (matches + 1);
+				stat_packet.gap_ticks = (stat_packet.gap_ticks * matches + rx.correl.received[i].gap_ticks) / (matches + 1);
 
 				// increment match counter for average calcs
 				matches++;
 			}
-			sprintf(usb_tx_buffer, "%" PRIu32 " word:%s len:%" PRIu16 " long_us:%" PRIu32 " short_us:%" PRIu32 " period_us:%" PRIu32 " logic:%u ignoresync:%u\r\n",
-					status & (RX_WORD_AVAILABLE << 16), stat_packet.word, rx.correl.last_match->len,
-					stat_packet.long_us, stat_packet.short_us, stat_packet.period_us,
-					(unsigned int) rx.correl.last_match->logic, (unsigned int) rx.ignore_sync_bit);
+			reportRxWord(&report, &stat_packet);
 			status &= ~(RX_WORD_AVAILABLE << 16);
+
+			// store the averaged word timing to a tx slot if learning was requested
+			if (tx.learn_slot >= 0) {
+				stat_packet.logic = rx.correl.last_match->logic;
+				if (learnTxSlot(&tx, tx.learn_slot, &stat_packet, matches, rx.ignore_sync_bit))
+					status |= (RX_WORD_LEARNED << 16);
+				else
+					status |= (RX_LEARN_FAILED << 16);
+			}
+		}
+		if ((status >> 16) & RX_WORD_LEARNED) {
+			TxSlot* slot = &tx.slots[tx.learn_slot];
+			reportU32(&report, status & (RX_WORD_LEARNED << 16));
+			reportField(&report, "slot", tx.learn_slot);
+			reportStr(&report, " word:");
+			reportStr(&report, slot->word);
+			reportField(&report, "long_us", TICKS_TO_US(slot->t_long_ticks));
+			reportField(&report, "short_us", TICKS_TO_US(slot->t_short_ticks));
+			reportField(&report, "delay_us", slot->frame_delay_us);
+			reportField(&report, "repeat", slot->frame_repeat);
+			reportField(&report, "logic", slot->invert_logic);
+			reportEnd(&report);
+			tx.learn_slot = -1;
+			status &= ~(RX_WORD_LEARNED << 16);
 		}
-		pushUSB();
+		if ((status >> 16) & RX_LEARN_FAILED) {
+			// the timing doesn't fit the transmitter or the arena is full; stop learning
+			reportU32(&report, status & (RX_LEARN_FAILED << 16));
+			reportField(&report, "slot", tx.learn_slot);
+			reportEnd(&report);
+			tx.learn_slot = -1;
+			status &= ~(RX_LEARN_FAILED << 16);
+		}
+		pushReport();
+	}
+
+	// send the next binary counters frame if streaming
+	uint8_t frame[COUNTERS_FRAME_SIZE];
+	uint16_t frame_len = countersStreamFrame(frame);
+	if (frame_len) {
+		queueReport(frame, frame_len);
 	}
 
 	// check when last USB activity was, and turn off activity LED after timeout
@@ -132,10 +266,59 @@ int USER_loop(void) {
 	if (delta > timeout_ms && HAL_GPIO_ReadPin(USB_ACT_GPIO_Port, USB_ACT_Pin) == GPIO_PIN_SET) {
 		HAL_GPIO_WritePin(USB_ACT_GPIO_Port, USB_ACT_Pin, GPIO_PIN_RESET);
 	}
+	return false;
+}
+
+// tasks in priority order; budgets in CPU cycles at 72 MHz
+Task tasks[] = {
+	{ "tx", txReady, txRun, 3600 }, // 50 us
+	{ "usbin", usbInReady, usbInRun, 3600 }, // 50 us
+	{ "decoder", decoderReady, decoderRun, 36000 }, // 500 us
+	{ "command", commandReady, commandRun, 72000 }, // 1 ms
+	{ "housekeeping", housekeepingReady, housekeepingRun, 72000 } // 1 ms
+};
+const uint8_t task_count = sizeof(tasks) / sizeof(Task);
+
+/*
+ * User-defined loop structure. There are 3 loop return conditions:
+ * return 0: loop should continue
+ * return >0: loop should terminate, no error handling; program will execute USER_shutdown
+ * return <0: loop should terminate, errors to report; program will execute USER_Error
+ */
+int USER_loop(void) {
+	countersLoop();
+
+	// run every task with work pending from what the interrupt handlers have posted
+	bool more_work = runTasks(tasks, task_count, takeEvents());
+
+	// sleep until the next interrupt posts an event (or the 1 ms tick)
+	if (!more_work) {
+		waitForEvent();
+	}
 
 	return 0;
 }
 
+/*
+ * Microseconds since boot, based on the HAL millisecond tick and the SysTick
+ * down-counter. Safe to call from interrupt handlers that block SysTick.
+ */
+uint32_t micros(void) {
+	uint32_t ms, val;
+	uint32_t load = SysTick->LOAD + 1;
+	do {
+		ms = HAL_GetTick();
+		val = SysTick->VAL;
+	} while (ms != HAL_GetTick());
+
+	// the tick interrupt may be pending if called from a higher priority ISR;
+	//   account for the millisecond it hasn't counted yet
+	if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) && val > (load >> 1))
+		ms++;
+
+	return ms * 1000 + ((load - val) * 1000) / load;
+}
+
 void USER_error(void) {
 	// blink LED based on error code 1's and 0's
 }
@@ -0,0 +1,86 @@
+/*
+ * counters.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#include "stm32f1xx_hal.h"
+
+#include "string.h"
+#include "stdint.h"
+
+#include "counters.h"
+
+volatile Counters counters;
+uint32_t counters_stream_ms = 0;
+
+static uint32_t loop_count = 0; // main loop passes in the current second
+static uint32_t second_start_ms = 0; // when the current second started
+static uint32_t last_stream_ms = 0; // when the last streamed frame was sent
+
+/*
+ * Count a main loop pass; updates the loop rate once per second
+ */
+void countersLoop(void) {
+	loop_count++;
+	uint32_t now = HAL_GetTick();
+	if (now - second_start_ms >= 1000) {
+		counters.loops_per_sec = loop_count;
+		loop_count = 0;
+		second_start_ms = now;
+	}
+}
+
+/*
+ * Zero all counters
+ */
+void countersReset(void) {
+	memset((void*) &counters, 0, sizeof(counters));
+}
+
+/*
+ * Check if the next frame of the counters stream is due
+ */
+bool countersStreamDue(void) {
+	return counters_stream_ms && HAL_GetTick() - last_stream_ms >= counters_stream_ms;
+}
+
+/*
+ * Serialize the next frame of the counters stream if it's due. Returns the
+ * frame length, or 0 if no frame is due.
+ */
+uint16_t countersStreamFrame(uint8_t* buf) {
+	if (!countersStreamDue())
+		return 0;
+	last_stream_ms = HAL_GetTick();
+	return countersFrame(buf);
+}
+
+/*
+ * Serialize the counters into a binary frame. 'buf' must hold COUNTERS_FRAME_SIZE
+ * bytes. Returns the frame length.
+ */
+uint16_t countersFrame(uint8_t* buf) {
+	Counters snapshot;
+	counters.uptime_ms = HAL_GetTick();
+	memcpy(&snapshot, (const void*) &counters, sizeof(snapshot));
+
+	uint16_t len = 0;
+	buf[len++] = COUNTERS_FRAME_MAGIC0;
+	buf[len++] = COUNTERS_FRAME_MAGIC1;
+	buf[len++] = COUNTERS_FRAME_VERSION;
+	buf[len++] = sizeof(snapshot);
+
+	// payload is written little-endian regardless of struct layout
+	uint8_t checksum = 0;
+	const uint32_t* fields = (const uint32_t*) &snapshot;
+	for (uint16_t i = 0; i < sizeof(snapshot) / sizeof(uint32_t); i++) {
+		for (uint8_t b = 0; b < 4; b++) {
+			buf[len] = (uint8_t) (fields[i] >> (8 * b));
+			checksum ^= buf[len++];
+		}
+	}
+	buf[len++] = checksum;
+	return len;
+}
@@ -0,0 +1,80 @@
+/*
+ * events.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#include "stm32f1xx_hal.h"
+
+#include "stdint.h"
+
+#include "events.h"
+
+EventStats event_stats = { true, 0, 0, 0 };
+
+static volatile uint32_t pending_events = 0; // event flags not yet taken by the main loop
+static volatile uint32_t first_post_cycles = 0; // cycle count when the oldest pending event was posted
+
+/*
+ * Start the DWT cycle counter used to time event latency
+ */
+void eventsInit(void) {
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+#ifdef DEBUG
+	// keep the debugger attached while the core sleeps
+	HAL_DBGMCU_EnableDBGSleepMode();
+#endif
+}
+
+/*
+ * Post event flags to the main loop. Safe to call from any interrupt priority.
+ */
+void postEvent(uint32_t events) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if (!pending_events) {
+		first_post_cycles = DWT->CYCCNT;
+	}
+	pending_events |= events;
+	__set_PRIMASK(primask);
+}
+
+/*
+ * Take and clear all pending event flags, recording how long the oldest one
+ * waited to be processed
+ */
+uint32_t takeEvents(void) {
+	__disable_irq();
+	uint32_t events = pending_events;
+	uint32_t posted = first_post_cycles;
+	pending_events = 0;
+	__enable_irq();
+
+	if (events) {
+		event_stats.last_cycles = DWT->CYCCNT - posted;
+		if (event_stats.last_cycles > event_stats.max_cycles)
+			event_stats.max_cycles = event_stats.last_cycles;
+		event_stats.wakes++;
+	}
+	return events;
+}
+
+/*
+ * Sleep until an interrupt occurs, unless an event is already pending. WFI
+ * with interrupts masked still wakes on a pending interrupt, so an event posted
+ * between the check and the sleep can't be missed.
+ */
+void waitForEvent(void) {
+	if (!event_stats.sleep_enabled)
+		return;
+
+	__disable_irq();
+	if (!pending_events) {
+		__WFI();
+	}
+	__enable_irq();
+}
@@ -0,0 +1,44 @@
+/*
+ * latency.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#include "stm32f1xx_hal.h"
+
+#include "string.h"
+#include "stdint.h"
+
+#include "latency.h"
+
+LatencyStats latency_stats[LATENCY_SOURCE_COUNT];
+
+const char* const latency_names[LATENCY_SOURCE_COUNT] = {
+	"tim2",
+	"dma"
+};
+
+/*
+ * Add an interrupt entry latency, in timer ticks, to the statistics of its source
+ */
+void latencyRecord(LatencySource source, uint32_t ticks) {
+	LatencyStats* stats = &latency_stats[source];
+	stats->count++;
+	stats->sum_ticks += ticks;
+	if (ticks > stats->max_ticks)
+		stats->max_ticks = ticks;
+
+	// bucket n holds latencies of 2^(n-1) to 2^n - 1 ticks
+	uint32_t bucket = 32 - __CLZ(ticks);
+	if (bucket >= LATENCY_HIST_BUCKETS)
+		bucket = LATENCY_HIST_BUCKETS - 1;
+	stats->hist[bucket]++;
+}
+
+/*
+ * Clear the latency statistics of all sources
+ */
+void latencyReset(void) {
+	memset(latency_stats, 0, sizeof(latency_stats));
+}
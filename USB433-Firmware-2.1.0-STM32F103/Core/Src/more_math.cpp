@@ -19,14 +19,6 @@ uint16_t max(uint16_t a, uint16_t b) {
 	return (a >= b) ? a : b;
 }
 
-float min(float a, float b) {
-	return (a <= b) ? a : b;
-}
-
-float max(float a, float b) {
-	return (a >= b) ? a : b;
-}
-
 /*
  * Find the mode of an array of unsigned integers
  */
@@ -0,0 +1,57 @@
+/*
+ * perf.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#include "stm32f1xx_hal.h"
+
+#include "string.h"
+#include "stdint.h"
+
+#include "perf.h"
+
+#ifdef PERF_ENABLED
+
+PerfStats perf_stats[PERF_REGION_COUNT];
+
+const char* const perf_names[PERF_REGION_COUNT] = {
+	"checkrx",
+	"rxword",
+	"processtx",
+	"processusb",
+	"captureisr",
+	"txdmaisr",
+	"rxreport"
+};
+
+/*
+ * Add a timed run of a region to its statistics
+ */
+void perfRecord(PerfRegion region, uint32_t cycles) {
+	PerfStats* stats = &perf_stats[region];
+	if (stats->count == 0 || cycles < stats->min_cycles)
+		stats->min_cycles = cycles;
+	if (cycles > stats->max_cycles)
+		stats->max_cycles = cycles;
+	stats->sum_cycles += cycles;
+	stats->count++;
+
+	// bucket 0 is < 64 cycles, each following bucket is 4x wider
+	int bucket = ((31 - (int) __CLZ(cycles | 1)) >> 1) - 2;
+	if (bucket < 0)
+		bucket = 0;
+	else if (bucket >= PERF_HIST_BUCKETS)
+		bucket = PERF_HIST_BUCKETS - 1;
+	stats->hist[bucket]++;
+}
+
+/*
+ * Clear the statistics of all regions
+ */
+void perfReset(void) {
+	memset(perf_stats, 0, sizeof(perf_stats));
+}
+
+#endif /* PERF_ENABLED */
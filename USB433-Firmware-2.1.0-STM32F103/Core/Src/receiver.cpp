@@ -6,39 +6,92 @@
  */
 
 #include "stm32f1xx_hal.h"
+#include "usbd_cdc_if.h"
 
 #include "string.h"
-#include "stdio.h"
 #include "stdint.h"
 
 #include "main.h"
 #include "receiver.h"
 #include "more_math.h"
+#include "events.h"
+#include "perf.h"
+#include "counters.h"
+#include "trace.h"
+#include "commands.h"
+#include "core_main.h"
+#include "report.h"
+#include "isr.h"
+#include "validate.h"
+#include "latency.h"
 
 uint8_t duty_tol = 15; // cutoff between "normal" and "abnormal" duty cycles. Must be between 1 and 49 for correct operation
-float period_lim = 1.3; // factor away from the mode period at which the period is replaced by the mode period
-uint16_t overflow_count; // counts how much the input capture timer has overflowed the count
-uint32_t measPeriodSorted[RX_BUFFER_SAMPLES];
-
-// for word computations
-uint32_t measLong[RX_MAX_BITS + 1];
-uint32_t measShort[RX_MAX_BITS + 1];
-uint32_t measPeriod[RX_MAX_BITS + 1];
+volatile uint16_t overflow_count; // counts how much the input capture timer has overflowed the count
+volatile uint32_t capture_carry = 0; // ticks of the current sample elapsed before the timer was reset by a gated edge
+static volatile uint32_t capture_seq = 0; // bumped by every TIM2 capture or overflow handled; see captureElapsed()
+static volatile bool overflow_early = false; // a capture counted the pending overflow before its update flag was handled
+static uint16_t irq_entry_count = 0; // TIM2 count at entry of the capture interrupt being handled
+static bool irq_time_falling = false; // the falling edge of this interrupt is timed once its capture is read
+static volatile bool sync_armed = false; // a sync pulse was seen; samples are being stored
+static uint16_t sync_samples = 0; // samples stored since the last sync pulse
+static volatile uint32_t chunk_end_us = 0; // local time the last period handed to the decoder ends
+static volatile bool sync_chunk_ready = false; // the sync detector closed a chunk; handed to the decoder once it's idle
+static volatile uint16_t sync_chunk_idx = 0; // target index of that chunk
+static volatile uint32_t sync_chunk_end_us = 0; // local time that chunk ends
+uint32_t measPeriodSorted[RX_MODE_SAMPLES];
 
 Receiver rx;
 
+// decoder state carried between slices of checkRxBuffers()
+static struct {
+	bool active = false; // a chunk of samples is being classified
+	uint32_t period_mode = 0; // most common period of the chunk
+	uint32_t time_ticks = 0; // time of the next rising edge, from the start of the chunk
+	uint32_t start_us = 0; // local time of the first rising edge of the chunk
+	RxTrack tracks[RX_TRACKS]; // transmissions being decoded concurrently
+} decode;
+
+// samples injected by the host are staged past stor_idx until the chunk ends
+static bool injecting = false;
+static uint16_t inject_idx = 0;
+
 /*
  * Initialize timers and parameters needed for OOK Rx operations
  */
 void rxInit(Receiver* settings) {
 	// set up Input capture monitoring of Receiver
 	overflow_count = 0;
+	capture_carry = 0;
+
+	// sample the input filter at 18 MHz, so the longest filter setting spans ~14 us
+	MODIFY_REG(TIM2->CR1, TIM_CR1_CKD, TIM_CLOCKDIVISION_DIV4);
+	setRxFilter(settings->ic_filter);
+
+	// count in capture ticks; the prescaler is loaded by an update event
+	TIM2->PSC = TICK_PRESCALER - 1;
+	TIM2->EGR = TIM_EGR_UG;
+
+	// only count overflows as updates, not the slave mode reset of every rising edge
+	SET_BIT(TIM2->CR1, TIM_CR1_URS);
+	TIM2->SR = (uint32_t) ~TIM_SR_UIF;
 
 	HAL_TIM_Base_Start_IT(&htim2);
     HAL_TIM_IC_Start_IT(&htim2, TIM_CHANNEL_1); // rising edge channel
     HAL_TIM_IC_Start_IT(&htim2, TIM_CHANNEL_2); // falling edge channel
 }
 
+/*
+ * Set the TIM2 input filter: the input has to be stable for a number of
+ * samples before an edge is seen (RM0008 TIMx_CCMR1 IC1F). Both capture
+ * channels and the reset trigger come from the filtered TI1.
+ */
+void setRxFilter(uint8_t filter) {
+	if (filter > RX_FILTER_MAX)
+		filter = RX_FILTER_MAX;
+	rx.ic_filter = filter;
+	MODIFY_REG(TIM2->CCMR1, TIM_CCMR1_IC1F, (uint32_t) filter << TIM_CCMR1_IC1F_Pos);
+}
+
 bool isRxEnabled() {
 	return HAL_GPIO_ReadPin(RX_EN_GPIO_Port, RX_EN_Pin) == (RX_RADIO_EN_POLARITY ? GPIO_PIN_SET : GPIO_PIN_RESET);
 }
@@ -63,24 +116,160 @@ void disableRx() {
  * Clear a receiver buffer to its zero state
  */
 void clearRxPacket(RxPacket* buf) {
-	memset(buf->word, 0, sizeof(buf->word));
+	arenaFree(buf->word);
+	buf->word = 0;
 	buf->len = 0;
-	buf->long_us = 0;
-	buf->short_us = 0;
-	buf->period_us = 0;
+	buf->long_ticks = 0;
+	buf->short_ticks = 0;
+	buf->period_ticks = 0;
+	buf->gap_ticks = 0;
+	buf->time_us = 0;
 	buf->logic = false;
 }
 
+/*
+ * Append a '0'/'1' bit to the word of a packet, growing its arena slot a block
+ * at a time. Returns false if the arena is full; received words leave
+ * RX_ARENA_RESERVE blocks free so the transmitter can still queue and learn.
+ */
+bool appendRxBit(RxPacket* buf, char bit) {
+	if (buf->len + 2 > arenaCapacity(buf->word)) {
+		char* word = (arenaFreeBlocks() > RX_ARENA_RESERVE) ? arenaResize(buf->word, buf->len + 2) : 0;
+		if (!word) {
+			counters.arena_failures++;
+			return false;
+		}
+		buf->word = word;
+	}
+	buf->word[buf->len++] = bit;
+	buf->word[buf->len] = 0;
+	return true;
+}
+
+/*
+ * Find the learned timing source matching a bit period. If no source is within
+ * 25% of the period, the least recently seen source is recycled for it.
+ */
+RxTimingSource* findTimingSource(uint32_t period_ticks) {
+	RxTimingSource* oldest = &rx.sources[0];
+	for (uint8_t i = 0; i < RX_LEARN_SOURCES; i++) {
+		RxTimingSource* src = &rx.sources[i];
+		uint32_t diff = (period_ticks > src->period_ticks) ? period_ticks - src->period_ticks : src->period_ticks - period_ticks;
+		if (src->hits && (diff << 2) <= src->period_ticks) {
+			// follow slow drift of the source bit rate
+			src->period_ticks += ((int32_t) period_ticks - (int32_t) src->period_ticks) / (1 << rx.learn_shift);
+			src->last_seen_ms = HAL_GetTick();
+			return src;
+		}
+		if (!src->hits || (oldest->hits && src->last_seen_ms < oldest->last_seen_ms))
+			oldest = src;
+	}
+
+	// start learning a new source from scratch
+	oldest->period_ticks = period_ticks;
+	oldest->short_ticks = 0;
+	oldest->long_ticks = 0;
+	oldest->hits = 0;
+	oldest->last_seen_ms = HAL_GetTick();
+	return oldest;
+}
+
+/*
+ * Move the short or long centroid of a source towards an observed pulse width
+ * (incremental k-means step, weighted as an EWMA by rx.learn_shift)
+ */
+void learnPulse(RxTimingSource* src, uint32_t width_ticks, bool is_short) {
+	uint32_t* centroid = is_short ? &src->short_ticks : &src->long_ticks;
+	if (*centroid == 0) {
+		// first pulse of this cluster seeds the centroid directly
+		*centroid = width_ticks;
+	} else {
+		*centroid += ((int32_t) width_ticks - (int32_t) *centroid) / (1 << rx.learn_shift);
+	}
+	if (src->hits < UINT16_MAX)
+		src->hits++;
+}
+
+/*
+ * Check if two packed words are at most correl->hamming bits apart
+ */
+static bool packedWithin(RxCorrelBuffer* correl, const uint32_t* a, const uint32_t* b) {
+	uint8_t distance = 0;
+	for (uint8_t i = 0; i < RX_PACKED_WORDS; i++) {
+		distance += __builtin_popcount(a[i] ^ b[i]);
+		if (distance > correl->hamming)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Check if two words of the correlation buffer count as repeats of each
+ * other: the same length, and at most correl->hamming bits apart
+ */
+static bool correlWithin(RxCorrelBuffer* correl, uint8_t a, uint8_t b) {
+	if (correl->received[a].len != correl->received[b].len)
+		return false;
+	return packedWithin(correl, correl->packed[a], correl->packed[b]);
+}
+
+/*
+ * Check if a word of the correlation buffer is a repeat of the last reported
+ * word. That word is compared from its copy, as its own slot may since have
+ * been reused by the ring.
+ */
+bool isCorrelRepeat(RxCorrelBuffer* correl, uint8_t index) {
+	if (!correl->reported_len || !correl->received[index].word)
+		return false;
+	if (correl->received[index].len != correl->reported_len)
+		return false;
+	return packedWithin(correl, correl->reported_packed, correl->packed[index]);
+}
+
+/*
+ * Rebuild a word of the correlation buffer in place, by per-bit majority vote
+ * over it and its repeats. A tie keeps the word's own bit.
+ */
+static void correlVote(RxCorrelBuffer* correl, uint8_t index) {
+	uint8_t repeats[RX_CORREL_WORDS];
+	uint8_t count = 0;
+	for (uint8_t i = 0; i < correl->index; i++) {
+		if (i != index && correlWithin(correl, index, i))
+			repeats[count++] = i;
+	}
+
+	RxPacket* packet = &correl->received[index];
+	uint32_t* packed = correl->packed[index];
+	for (uint8_t bit = 0; bit < packet->len; bit++) {
+		uint32_t mask = 1UL << (bit & 31);
+		uint8_t word = bit >> 5;
+		bool own = packed[word] & mask;
+		uint8_t ones = own;
+		for (uint8_t i = 0; i < count; i++)
+			ones += (correl->packed[repeats[i]][word] & mask) != 0;
+
+		// 'count' repeats and the word itself vote
+		bool one = 2 * ones > count + 1 || (2 * ones == count + 1 && own);
+		if (one != own) {
+			packed[word] ^= mask;
+			packet->word[bit] = one ? '1' : '0';
+		}
+	}
+}
+
 /*
  * Callback to fire when a word is ready. Data is in buffer, length of
  * word is 'count'
  */
 void receivedWord(RxCorrelBuffer* correl, RxPacket* data) {
+	PERF_SCOPE(PERF_RX_WORD);
+
 	// ignore the word if it's outside the bounds of min and max word lengths
-	if (data->len < correl->min_word_len || data->len > correl->max_word_len + (rx.ignore_sync_bit ? 0 : 1)) return;
-	data->long_us = mode(measLong, data->len);
-	data->short_us = mode(measShort, data->len);
-	data->period_us = mode(measPeriod, data->len);
+	if (data->len < correl->min_word_len || data->len > correl->max_word_len + (rx.ignore_sync_bit ? 0 : 1)) {
+		counters.words_rejected_len++;
+		return;
+	}
+	counters.words_decoded++;
 
 	// if the correlation cache has timed out, clear it before adding
 	uint32_t delta = 0;
@@ -90,191 +279,652 @@ void receivedWord(RxCorrelBuffer* correl, RxPacket* data) {
 		delta = HAL_GetTick() - correl->last_word_time_ms;
 
 	if (delta * 1000 >= correl->timeout_us) {
-		for (uint8_t i = 0; i <= correl->index; i++) {
+		for (uint8_t i = 0; i < RX_CORREL_WORDS; i++) {
 			clearRxPacket(&correl->received[i]);
 		}
 		correl->last_match = 0;
+		correl->reported_len = 0;
 		correl->index = 0;
 	}
 
-	// inject packet to correlation buffer and log time
+	// inject packet to correlation buffer and log time; the word moves over
+	//   without copying, trimmed to its length
+	clearRxPacket(&correl->received[correl->index]);
+	char* word = arenaResize(data->word, data->len + 1);
+	data->word = 0;
+	if (!word) {
+		counters.arena_failures++;
+		return;
+	}
+	correl->received[correl->index].word = word;
 	correl->received[correl->index].len = data->len;
-	correl->received[correl->index].long_us = data->long_us;
-	correl->received[correl->index].short_us = data->short_us;
-	correl->received[correl->index].period_us = data->period_us;
+	correl->received[correl->index].long_ticks = data->long_ticks;
+	correl->received[correl->index].short_ticks = data->short_ticks;
+	correl->received[correl->index].period_ticks = data->period_ticks;
+	correl->received[correl->index].gap_ticks = data->gap_ticks;
+	correl->received[correl->index].time_us = data->time_us;
 	correl->received[correl->index].logic = data->logic;
-	memcpy(correl->received[correl->index].word, data->word, sizeof(data->word));
 
+	uint32_t* packed = correl->packed[correl->index];
+	memset(packed, 0, sizeof(correl->packed[0]));
+	for (uint8_t i = 0; i < data->len; i++) {
+		if (word[i] == '1')
+			packed[i >> 5] |= 1UL << (i & 31);
+	}
+
+	// a word failing the checksum of its length is corrupt; later frames may pass
+	RxValidator* validator = findValidator(data->len);
+	if (validator && !validateWord(validator, packed, data->len)) {
+		clearRxPacket(&correl->received[correl->index]);
+		counters.words_rejected_check++;
+		traceRecord(TRACE_WORD, data->len, false);
+		return;
+	}
+
+	uint8_t slot = correl->index;
 	correl->index = (correl->index + 1) % RX_CORREL_WORDS;
 	correl->last_word_time_ms = HAL_GetTick();
 
 	RxPacket* this_match = 0;
+	if (validator) {
+		// the checksum vouches for the word; report it from its first frame,
+		//   but only once per burst. Only exact repeats are suppressed, as a
+		//   word differing in a few bits is a new valid word
+		bool repeat = correl->reported_len == data->len
+				&& memcmp(correl->reported_packed, packed, sizeof(correl->reported_packed)) == 0;
+		if (!repeat) {
+			this_match = &correl->received[slot];
+			counters.words_validated++;
+		}
+	}
+
 	// run correlation; call to user feedback function if correlation
-	// is above the defined threshold
-	for (int i = 0; i < (int) correl->index - (int) correl->match_thresh; i++) {
+	// is above the defined threshold. Words within correl->hamming bits of
+	// each other count as repeats
+	int end = validator ? 0 : (int) correl->index - (int) correl->match_thresh;
+	for (int i = 0; i < end; i++) {
 		uint8_t matches = 1;
-		// skip any matching of the last sent word
-		if (strcmp(correl->last_match->word, correl->received[i].word) == 0)
+		// skip any matching of the last sent word, and words validated by checksum
+		if (isCorrelRepeat(correl, i) || findValidator(correl->received[i].len))
 			continue;
 
 		for (int j = i + 1; j < correl->index; j++) {
-			// skip this j if string lengths mismatch
-			if (strlen(correl->received[i].word) != strlen(correl->received[j].word))
-				continue;
-
-			// check if the strings match
-			if (strcmp(correl->received[i].word, correl->received[j].word) == 0)
+			if (correlWithin(correl, i, j))
 				matches++;
 		}
 
 		// check if match count is greater than the threshold
 		if (matches >= correl->match_thresh) {
+			// bits flipped in some repeats are outvoted by the others
+			if (correl->hamming)
+				correlVote(correl, i);
 			this_match = &correl->received[i];
 			break;
 		}
 	}
 
-	if (this_match && correl->last_match != this_match) {
-		// match threshold met; make sure it hasn't already been sent
+	// repeats of the last reported word were skipped above, so a match is new
+	bool correlated = this_match != 0;
+	if (correlated) {
 		status |= (RX_WORD_AVAILABLE << 16);
 		correl->last_match = this_match;
+		memcpy(correl->reported_packed, correl->packed[this_match - correl->received], sizeof(correl->reported_packed));
+		correl->reported_len = this_match->len;
+		counters.words_correlated++;
 	}
+	traceRecord(TRACE_WORD, data->len, correlated);
 }
 
 /*
- * Check if there's a sentence ready to be processed
+ * Check if a bit period is already followed by an active track
  */
-void checkRxBuffers() {
-	// FIXME: overflow entry logic with overflow_count enabled
-	// check for end of a word via timeout operation; only act if there's no period info
-	if (((overflow_count << 16) + TIM2->CNT) >= rx.bit_max_period && rx.tgt_idx ^ rx.stor_idx) {
-		// if there's been a counter overflow
-		// mark the end of the sample and increment the storage idx
-		if (rx.measured_widths[rx.stor_idx]) {
-			rx.measured_periods[rx.stor_idx] = (overflow_count << 16) + TIM2->CNT;
-			overflow_count = 0;
-			rx.stor_idx++;
-			rx.stor_idx %= RX_BUFFER_SAMPLES;
+static bool trackPeriodInUse(uint32_t period_ticks) {
+	for (uint8_t i = 0; i < RX_TRACKS; i++) {
+		RxTrack* track = &decode.tracks[i];
+		uint32_t diff = (period_ticks > track->period_ticks) ? period_ticks - track->period_ticks : track->period_ticks - period_ticks;
+		if (track->active && (diff << 2) <= period_ticks)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Find the active track expecting a rising edge at 'now': the one whose next
+ * bit is due closest to it, within 25% of its bit period
+ */
+static RxTrack* matchTrack(uint32_t now) {
+	RxTrack* best = 0;
+	uint32_t best_err = UINT32_MAX;
+	for (uint8_t i = 0; i < RX_TRACKS; i++) {
+		RxTrack* track = &decode.tracks[i];
+		if (!track->active || !track->pulses)
+			continue;
+		uint32_t due = track->last_rise_ticks + track->period_ticks;
+		uint32_t err = (now > due) ? now - due : due - now;
+		if ((err << 2) <= track->period_ticks && err < best_err) {
+			best = track;
+			best_err = err;
 		}
+	}
+	return best;
+}
 
-		rx.tgt_idx = rx.stor_idx;
+/*
+ * Start a track at a rising edge no active track expects. The chunk's most
+ * common period is assumed unless a track already follows it, in which case
+ * a learned source with an unused bit period is tried. Returns 0 if every
+ * track is busy.
+ */
+static RxTrack* startTrack(uint32_t now) {
+	RxTrack* track = 0;
+	for (uint8_t i = 0; i < RX_TRACKS && !track; i++) {
+		if (!decode.tracks[i].active)
+			track = &decode.tracks[i];
+	}
+	if (!track)
+		return 0;
+
+	uint32_t period_ticks = decode.period_mode;
+	if (trackPeriodInUse(period_ticks)) {
+		for (uint8_t i = 0; i < RX_LEARN_SOURCES; i++) {
+			RxTimingSource* src = &rx.sources[i];
+			if (src->hits >= RX_LEARN_MIN_HITS && !trackPeriodInUse(src->period_ticks)) {
+				period_ticks = src->period_ticks;
+				break;
+			}
+		}
 	}
 
-	if(rx.proc_idx == rx.tgt_idx)
-		// sample to process is equal to target index; return
-		return;
+	track->active = true;
+	track->period_ticks = period_ticks;
+	track->last_rise_ticks = now;
+	track->pending_width = 0;
+	track->pulses = 0;
+	track->src = rx.adaptive ? findTimingSource(period_ticks) : 0;
+	clearRxPacket(&track->packet);
+	track->packet.logic = rx.invert_logic;
+	track->packet.time_us = decode.start_us + TICKS_TO_US(now);
+	track->sum_short_ticks = 0;
+	track->sum_long_ticks = 0;
+	track->sum_period_ticks = 0;
+	track->timed_bits = 0;
+	track->dropped = false;
+	return track;
+}
 
-	// get a count of how many samples were in last chunk; copy data for sorting in buffers
-	uint16_t sample_ct = 0;
-	memset(measPeriodSorted, 0, sizeof(measPeriodSorted));
-	if(rx.tgt_idx < rx.proc_idx) {
-		// rollover occurred
-		sample_ct = (RX_BUFFER_SAMPLES - rx.proc_idx) + rx.tgt_idx;
-		// copy data to buffers for sorting and processing
-		memcpy(measPeriodSorted, &rx.measured_periods[rx.proc_idx], (RX_BUFFER_SAMPLES - rx.proc_idx) * sizeof(rx.measured_periods[0]));
-		memcpy(measPeriodSorted + (RX_BUFFER_SAMPLES - rx.proc_idx), rx.measured_periods, (rx.tgt_idx) * sizeof(rx.measured_periods[0]));
-	} else {
-		// get simple difference (zero case already handled)
-		sample_ct = rx.tgt_idx - rx.proc_idx;
-		// copy data to buffers for sorting and processing
-		memcpy(measPeriodSorted, &rx.measured_periods[rx.proc_idx], sample_ct * sizeof(rx.measured_periods[0]));
+/*
+ * Classify a pulse of a track as a bit, now that the next rising edge of the
+ * track (or the gap ending its word) gives the pulse period
+ */
+static void trackPulse(RxTrack* track, uint32_t period_ticks, uint32_t width_ticks, bool gap) {
+	// classify against the nearest learned centroid once the source is known,
+	//   otherwise fall back to the fixed 50% duty rule
+	RxTimingSource* src = track->src;
+	bool is_short = (width_ticks << 1) < track->period_ticks;
+	if (src && src->hits >= RX_LEARN_MIN_HITS && src->short_ticks && src->long_ticks) {
+		is_short = (width_ticks << 1) < (src->short_ticks + src->long_ticks);
+	}
+
+	if (!gap) {
+		// only pulses inside a word describe the source timings
+		if (src)
+			learnPulse(src, width_ticks, is_short);
+		// follow slow drift of the bit rate
+		track->period_ticks += ((int32_t) period_ticks - (int32_t) track->period_ticks) / (1 << rx.learn_shift);
+	}
+
+	// because the received word for OOK can have a sync bit
+	//   at the start, optionally ignore the first bit of the received string
+	RxPacket* packet = &track->packet;
+	if ((track->pulses > 1 || !rx.ignore_sync_bit) && packet->len < RX_MAX_BITS && !track->dropped) {
+		if (!appendRxBit(packet, (is_short ^ rx.invert_logic) ? '1' : '0')) {
+			// a word missing a bit is corrupt; drop it rather than report it shifted
+			clearRxPacket(packet);
+			track->dropped = true;
+			return;
+		}
+		if (!gap) {
+			track->sum_short_ticks += is_short ? width_ticks : period_ticks - width_ticks;
+			track->sum_long_ticks += is_short ? period_ticks - width_ticks : width_ticks;
+			track->sum_period_ticks += period_ticks;
+			track->timed_bits++;
+		}
 	}
+}
 
-	// get the period for the bit rate based on the mode of periods
-	uint32_t period_mode = mode(measPeriodSorted, sample_ct);
+/*
+ * End the word of a track at 'now', after its last pulse, and hand it to the
+ * correlation logic
+ */
+static void endTrack(RxTrack* track, uint32_t now) {
+	uint32_t gap_ticks = now - track->last_rise_ticks;
+	if (track->pulses)
+		trackPulse(track, gap_ticks, track->pending_width, true);
+
+	RxPacket* packet = &track->packet;
+	if (packet->len > 0) {
+		uint8_t n = track->timed_bits ? track->timed_bits : 1;
+		packet->short_ticks = track->sum_short_ticks / n;
+		packet->long_ticks = track->sum_long_ticks / n;
+		packet->period_ticks = track->timed_bits ? track->sum_period_ticks / n : track->period_ticks;
+		packet->gap_ticks = gap_ticks;
+		uint32_t gap_us = TICKS_TO_US(gap_ticks);
+		traceRecord(TRACE_GAP, 0, (gap_us > UINT16_MAX) ? UINT16_MAX : gap_us);
+		receivedWord(&rx.correl, packet);
+	}
+	// release the word if it wasn't taken over by the correlation buffer
+	clearRxPacket(packet);
+	track->active = false;
+}
 
-	// define a buffer to store temporary received word data
-	RxPacket packet;
-	memset(packet.word, 0, sizeof(packet.word));
-	packet.logic = rx.invert_logic;
+/*
+ * Time since the last rising edge in capture ticks, extended past the 16 bit
+ * TIM2 count by the overflows counted since. The read is retried if the TIM2
+ * interrupt ran in between, and accounts for an edge or overflow its interrupt
+ * hasn't handled yet. 'seq' gets the capture sequence the result is consistent with.
+ */
+static uint32_t captureElapsed(uint32_t* seq) {
+	uint32_t before, elapsed;
+	do {
+		before = capture_seq;
+		uint32_t overflows = overflow_count;
+		uint32_t count = TIM2->CNT;
+		uint32_t flags = TIM2->SR;
+		if (flags & TIM_SR_CC1IF) {
+			// a rising edge restarted the count; its overflows are about to be cleared
+			overflows = 0;
+		} else if ((flags & TIM_SR_UIF) && overflows < UINT16_MAX) {
+			// the count wrapped and the overflow isn't counted yet; take a count from after the wrap
+			overflows++;
+			count = TIM2->CNT;
+		}
+		elapsed = (overflows << 16) + count;
+	} while (before != capture_seq);
 
-	// clear measurement buffers for short, long, and period values
-	memset(measLong, 0, sizeof(measLong));
-	memset(measShort, 0, sizeof(measShort));
-	memset(measPeriod, 0, sizeof(measPeriod));
+	*seq = before;
+	return elapsed;
+}
 
-	// note word start index
-	uint16_t word_start_idx = rx.proc_idx;
+/*
+ * Check if there's a sentence ready to be processed. Work is split into slices
+ * so a long capture doesn't hold up other tasks: one slice finds the most
+ * common period among the first RX_MODE_SAMPLES samples of a new chunk, then
+ * each following slice handles up to RX_DECODE_SLICE samples. Every rising
+ * edge is assigned to the track that expects it, so transmitters keying at
+ * the same time are decoded as separate words. Returns true while the chunk
+ * isn't finished.
+ */
+bool checkRxBuffers() {
+	PERF_SCOPE(PERF_CHECK_RX);
+
+	if (!decode.active) {
+		// take a chunk the sync detector closed while the last one was being decoded
+		if (sync_chunk_ready) {
+			uint32_t primask = __get_PRIMASK();
+			__disable_irq();
+			rx.tgt_idx = sync_chunk_idx;
+			chunk_end_us = sync_chunk_end_us;
+			sync_chunk_ready = false;
+			__set_PRIMASK(primask);
+		}
+
+		// check for end of a word via timeout operation; only act if there's no period info
+		uint32_t seq;
+		uint32_t elapsed = captureElapsed(&seq);
+		if (elapsed >= US_TO_TICKS(rx.bit_max_period) && rx.tgt_idx ^ rx.stor_idx) {
+			// the sample is closed with the capture interrupt masked, and only if
+			//   no capture or overflow came in since 'elapsed' was read
+			uint32_t primask = __get_PRIMASK();
+			__disable_irq();
+			if (seq == capture_seq && !(TIM2->SR & (TIM_SR_CC1IF | TIM_SR_CC2IF | TIM_SR_UIF))) {
+				// mark the end of the sample and increment the storage idx
+				if (rx.measured_widths[rx.stor_idx]) {
+					rx.measured_periods[rx.stor_idx] = elapsed + capture_carry;
+					overflow_count = 0;
+					capture_carry = 0;
+					rx.stor_idx++;
+					rx.stor_idx %= RX_BUFFER_SAMPLES;
+					chunk_end_us = micros();
+				} else {
+					// the last stored period ended at the last rising edge
+					chunk_end_us = micros() - TICKS_TO_US(elapsed);
+				}
+
+				rx.tgt_idx = rx.stor_idx;
+				sync_armed = false; // the transmission ended; wait for the next sync
+			}
+			__set_PRIMASK(primask);
+		}
 
-	// loop through samples to build word; since
-	while(rx.proc_idx != rx.tgt_idx) {
-		// period measured is approximately equal to the mode of periods
-		// now check duty cycle to determine whether it's a '1' or '0'
+		if(rx.proc_idx == rx.tgt_idx)
+			// sample to process is equal to target index; return
+			return false;
+
+		// get a count of how many samples were in last chunk (zero case already handled)
+		uint16_t sample_ct = (rx.tgt_idx + RX_BUFFER_SAMPLES - rx.proc_idx) % RX_BUFFER_SAMPLES;
+
+		// the chunk ends at chunk_end_us; its periods date its first rising edge.
+		//   The periods from its start are copied for sorting, up to RX_MODE_SAMPLES
+		//   so the sort takes bounded time however long the chunk is
+		uint16_t sort_ct = min(sample_ct, RX_MODE_SAMPLES);
+		uint32_t chunk_ticks = 0;
+		for (uint16_t i = 0, idx = rx.proc_idx; i < sample_ct; i++) {
+			chunk_ticks += rx.measured_periods[idx];
+			if (i < sort_ct)
+				measPeriodSorted[i] = rx.measured_periods[idx];
+			idx = (idx + 1) % RX_BUFFER_SAMPLES;
+		}
+		decode.start_us = chunk_end_us - TICKS_TO_US(chunk_ticks);
+
+		// the most common period seeds the bit period of new tracks; the start
+		//   of the chunk is two frames of a common 24 bit word
+		decode.period_mode = mode(measPeriodSorted, sort_ct);
+		decode.time_ticks = 0;
+		for (uint8_t i = 0; i < RX_TRACKS; i++)
+			decode.tracks[i].active = false;
+		decode.active = true;
+
+		// sorting is the costly step; classify samples in the following slices
+		return true;
+	}
+
+	// samples of this slice, for the raw report
+	char raw_line[RX_RAW_LINE_LEN];
+	Report raw;
+	reportBegin(&raw, raw_line, sizeof(raw_line));
+	reportStr(&raw, "0 raw:");
+	uint16_t raw_start = raw.len;
+
+	// loop through samples, assigning each pulse to a track, up to the slice limit
+	uint16_t slice = RX_DECODE_SLICE;
+	while(rx.proc_idx != rx.tgt_idx && slice--) {
 		uint32_t this_period = (rx.measured_periods[rx.proc_idx]);
 		uint32_t this_width = (rx.measured_widths[rx.proc_idx]);
-		uint16_t duty_pct = (uint16_t) ((float) (this_width * 100) / (float) period_mode);
-
-		// because the received word for OOK can have a sync bit
-		//   at the start, optionally ignore the first bit of the received string
-		if ((rx.ignore_sync_bit && rx.proc_idx ^ word_start_idx) || !rx.ignore_sync_bit) {
-			measPeriod[packet.len] = (this_period > rx.correl.timeout_us) ? period_mode : this_period;
-			if (duty_pct < 50) {
-				packet.word[packet.len] = rx.invert_logic ? '0' : '1';
-				measShort[packet.len] = this_width;
-				measLong[packet.len] = measPeriod[packet.len] - measShort[packet.len];
-			} else {
-				packet.word[packet.len] = rx.invert_logic ? '1' : '0';
-				measLong[packet.len] = this_width;
-				measShort[packet.len] = measPeriod[packet.len] - measLong[packet.len];
+		if (rx.raw) {
+			if (raw.len > raw_start)
+				reportChar(&raw, ' ');
+			reportU32(&raw, TICKS_TO_US(this_period));
+			reportChar(&raw, ',');
+			reportU32(&raw, TICKS_TO_US(this_width));
+		}
+
+		uint32_t now = decode.time_ticks;
+		for (uint8_t i = 0; i < RX_TRACKS; i++) {
+			RxTrack* track = &decode.tracks[i];
+			if (track->active && now - track->last_rise_ticks > (track->period_ticks * RX_PERIOD_LIM_Q8) >> 8) {
+				// the track went quiet for longer than a bit; its word ends
+				endTrack(track, now);
 			}
-			packet.len++;
 		}
 
+		RxTrack* track = matchTrack(now);
+		if (!track)
+			track = startTrack(now);
+		if (track) {
+			if (track->pulses)
+				trackPulse(track, now - track->last_rise_ticks, track->pending_width, false);
+			track->pending_width = this_width;
+			track->last_rise_ticks = now;
+			track->pulses++;
+		}
+		decode.time_ticks += this_period;
+
 		// increment sample to look at next, and clear this sample
 		rx.measured_periods[rx.proc_idx] = 0;
 		rx.measured_widths[rx.proc_idx] = 0;
 
 		rx.proc_idx++;
 		rx.proc_idx %= RX_BUFFER_SAMPLES;
+	}
 
-		// handle processing the word to the correlation logic
-		if (this_period > period_mode * period_lim && packet.len > 0) {
-			// Entry conditions:
-			// - the period observed is significantly larger than the mode period (i.e. inter-word delay)
-			// - packet data is longer than 0 bits
-
-			receivedWord(&rx.correl, &packet);
-			clearRxPacket(&packet);
-			word_start_idx = rx.proc_idx;
+	if (rx.proc_idx == rx.tgt_idx) {
+		// the chunk ended with a word timeout; every track's word is complete
+		for (uint8_t i = 0; i < RX_TRACKS; i++) {
+			if (decode.tracks[i].active)
+				endTrack(&decode.tracks[i], decode.time_ticks);
 		}
 	}
+
+	if (rx.raw) {
+		reportEnd(&raw);
+		queueReport((uint8_t*) raw_line, raw.len);
+	}
+
+	// chunk is done once every sample up to the target has been classified
+	decode.active = rx.proc_idx != rx.tgt_idx;
+	return decode.active;
+}
+
+/*
+ * Check if samples can be injected: the radio is off, so nothing is being
+ * captured, and the decoder has finished every stored sample
+ */
+bool rxInjectReady(void) {
+	return !isRxEnabled() && !decode.active && rx.proc_idx == rx.stor_idx;
 }
 
-// ==================== HAL ISR Callback ==========================
+/*
+ * Store a sample to the capture buffer as if the input capture had measured
+ * it. Samples are staged, so a chunk can be built over several calls, until
+ * injectRxEnd(). Returns false if the buffer is full.
+ */
+bool injectRxSample(uint32_t period_us, uint32_t width_us) {
+	if (!injecting) {
+		inject_idx = rx.stor_idx;
+		injecting = true;
+	}
+	uint16_t next = (inject_idx + 1) % RX_BUFFER_SAMPLES;
+	if (next == rx.proc_idx)
+		return false;
+
+	rx.measured_periods[inject_idx] = US_TO_TICKS(period_us);
+	rx.measured_widths[inject_idx] = US_TO_TICKS(width_us);
+	inject_idx = next;
+	return true;
+}
 
 /*
- * Input capture callback for measuring PWM values of input signal
+ * Finish the staged chunk of injected samples: hand it to the decoder if
+ * 'keep', otherwise drop it
  */
-void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim) {
-	if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_1) { // if interrupt is rising edge
+void injectRxEnd(bool keep) {
+	if (injecting && keep) {
+		rx.stor_idx = inject_idx;
+		rx.tgt_idx = rx.stor_idx;
+		chunk_end_us = micros(); // injected samples are dated as if they just ended
+		postEvent(EVT_RX_EDGE);
+	}
+	injecting = false;
+}
+
+// ==================== ISR and HAL Callbacks ====================
+
+/*
+ * Count a TIM2 overflow into the sample being measured
+ */
+static void countOverflow(void) {
+	// the count saturates after 2^32 ticks (~71 minutes at 1 us ticks)
+	capture_seq++;
+	if (overflow_count < UINT16_MAX)
+		overflow_count++;
+}
+
+/*
+ * Measure the input signal from a TIM2 capture: a rising edge (channel 1)
+ * ends the period of a sample, a falling edge (channel 2) its width.
+ * 'capture' is the captured count.
+ */
+static void rxCapture(bool rising, uint16_t capture) {
+	// the update flag is handled after the captures. If it's pending and the
+	//   edge was captured early in the count, the wrap came before the edge
+	//   and belongs to this sample; a wrap after it would take a whole count
+	if ((TIM2->SR & TIM_SR_UIF) && capture < 0x8000 && !overflow_early) {
+		countOverflow();
+		overflow_early = true;
+	}
+	capture_seq++;
+	if (!rising && irq_time_falling) {
+		// the count runs on from the falling edge's capture
+		irq_time_falling = false;
+		latencyRecord(LATENCY_TIM2_CAPTURE, (uint16_t) (irq_entry_count - capture));
+	}
+	if (rx.blind) {
+		// receiver is off while transmitting; drop any partial sample so the
+		//   first edge after re-enabling starts a fresh one
+		rx.measured_widths[rx.stor_idx] = 0;
+		overflow_count = 0;
+		capture_carry = 0;
+		sync_armed = false;
+		return;
+	}
+	counters.edges++;
+
+	if (rising) {
 		// get period between last 2 rising edges
-		uint16_t delta = HAL_TIM_ReadCapturedValue(htim, TIM_CHANNEL_1) + 1; // correct for 0-based counting
+		uint16_t delta = capture + 1; // correct for 0-based counting
+		traceRecord(TRACE_EDGE, 1, delta);
+		uint32_t period = delta + ((uint32_t) overflow_count << 16) + capture_carry;
+		overflow_count = 0;
+
+		if (period < US_TO_TICKS(rx.min_period_us) && rx.measured_widths[rx.stor_idx]) {
+			// a notch in the carrier; the timer restarted here, so carry the
+			//   elapsed time into the width and period of the current sample
+			capture_carry = period;
+			counters.gated_periods++;
+			return;
+		}
+		capture_carry = 0;
 
 		// store period to buffer
-		rx.measured_periods[rx.stor_idx] = delta + (overflow_count << 16);
-		overflow_count = 0;
+		rx.measured_periods[rx.stor_idx] = period;
+
+		if (rx.sync && rx.measured_widths[rx.stor_idx]) {
+			uint32_t width = rx.measured_widths[rx.stor_idx];
+			if (period >= US_TO_TICKS(rx.sync_gap_us) && width <= US_TO_TICKS(rx.sync_high_us)) {
+				// sync pulse; store it and what follows. Each repeated frame restarts the count
+				if (!sync_armed)
+					counters.sync_arms++;
+				sync_armed = true;
+				sync_samples = 0;
+			} else if (!sync_armed) {
+				// idle: the slot is reused by the next sample
+				return;
+			} else if (++sync_samples >= RX_SYNC_MAX_SAMPLES) {
+				// longer than any word; store this sample, hand the chunk to the
+				//   decoder and go back to idle (noise keeps the word timeout from firing).
+				//   The decoder may be mid-chunk, so it takes the target once it's done
+				sync_armed = false;
+				sync_chunk_idx = (rx.stor_idx + 1) % RX_BUFFER_SAMPLES;
+				sync_chunk_end_us = micros();
+				sync_chunk_ready = true;
+			}
+		}
 
 		if(rx.measured_widths[rx.stor_idx]) {
+			// the decoder hasn't caught up; this sample overwrites the oldest unprocessed one
+			if ((rx.stor_idx + 1) % RX_BUFFER_SAMPLES == rx.proc_idx)
+				counters.samples_overrun++;
+
 			// increment the current sample mod sample count
 			rx.stor_idx++;
 			rx.stor_idx %= RX_BUFFER_SAMPLES;
+			postEvent(EVT_RX_EDGE);
 		}
-	} else if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_2) { // if interrupt is falling edge (duty cycle info)
+	} else { // falling edge (duty cycle info)
 		// capture pulse width
-		uint16_t delta = HAL_TIM_ReadCapturedValue(htim, TIM_CHANNEL_2) + 1; // correct for 0-based counting
+		uint16_t delta = capture + 1; // correct for 0-based counting
+		traceRecord(TRACE_EDGE, 2, delta);
+		// TIM2 only restarts on rising edges; the overflows keep counting
+		//   towards the period, so the width takes a copy
+		uint32_t overflows = overflow_count;
+		uint32_t width = delta + (overflows << 16) + capture_carry;
+
+		if (width < US_TO_TICKS(rx.min_width_us)) {
+			// a glitch pulse; its rising edge already closed the previous sample,
+			//   so reopen that one if the decoder hasn't been handed it yet
+			counters.gated_widths++;
+			rx.measured_widths[rx.stor_idx] = 0;
+			if (rx.stor_idx != rx.tgt_idx && !(sync_chunk_ready && rx.stor_idx == sync_chunk_idx)
+					&& (sync_armed || !rx.sync)) {
+				rx.stor_idx = (rx.stor_idx + RX_BUFFER_SAMPLES - 1) % RX_BUFFER_SAMPLES;
+				capture_carry = rx.measured_periods[rx.stor_idx];
+			} else {
+				capture_carry = 0;
+			}
+			return;
+		}
 
 		// save the measurement
-		rx.measured_widths[rx.stor_idx] = delta + (overflow_count << 16);
-		overflow_count = 0;
+		rx.measured_widths[rx.stor_idx] = width;
+	}
+}
+
+/*
+ * Handle the TIM2 update flag. With URS set, only real overflows land here,
+ * not the reset of a rising edge.
+ */
+static void rxOverflow(void) {
+	if (overflow_early) {
+		// already counted by the capture it came before
+		overflow_early = false;
+		return;
+	}
+	countOverflow();
+}
+
+/*
+ * TIM2 interrupt. The fast path reads and clears the capture and update flags
+ * directly, in the order HAL_TIM_IRQHandler handles them; the TIM2 interrupts
+ * enabled are CC1, CC2 and update. A wrap pending with an edge is placed by
+ * rxCapture().
+ */
+void rxCaptureIRQ(void) {
+	// entry latency: rising edges reset the count (slave reset mode), so the
+	//   count is the time since the edge. A falling edge is only timed without
+	//   a rising edge pending, from its capture in rxCapture(). An edge captured
+	//   while the count is read leaves it ambiguous; then nothing is timed
+	uint32_t pending = TIM2->SR;
+	irq_entry_count = TIM2->CNT;
+	if (!((TIM2->SR ^ pending) & (TIM_SR_CC1IF | TIM_SR_CC2IF))) {
+		if (pending & TIM_SR_CC1IF)
+			latencyRecord(LATENCY_TIM2_CAPTURE, irq_entry_count);
+		else if (pending & TIM_SR_CC2IF)
+			irq_time_falling = true;
+	}
+	PERF_SCOPE(PERF_CAPTURE_ISR);
+#ifdef ISR_FAST_PATH
+	uint32_t flags = TIM2->SR & TIM2->DIER;
+	if (flags & TIM_SR_CC1IF) {
+		TIM2->SR = (uint32_t) ~TIM_SR_CC1IF;
+		rxCapture(true, TIM2->CCR1);
 	}
+	if (flags & TIM_SR_CC2IF) {
+		TIM2->SR = (uint32_t) ~TIM_SR_CC2IF;
+		rxCapture(false, TIM2->CCR2);
+	}
+	if (flags & TIM_SR_UIF) {
+		TIM2->SR = (uint32_t) ~TIM_SR_UIF;
+		rxOverflow();
+	}
+#else
+	HAL_TIM_IRQHandler(&htim2);
+#endif
+	irq_time_falling = false;
 }
 
 /*
- * Timer Overflowed interrupt
+ * Input capture callback of the HAL dispatch
+ */
+void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim) {
+	if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_1)
+		rxCapture(true, HAL_TIM_ReadCapturedValue(htim, TIM_CHANNEL_1));
+	else if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_2)
+		rxCapture(false, HAL_TIM_ReadCapturedValue(htim, TIM_CHANNEL_2));
+}
+
+/*
+ * Timer Overflowed interrupt of the HAL dispatch
  */
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
-	// discard the current sample if the timer period elapses
-	// however this is also called on the rising edge (since it resets the timer)
-	if (overflow_count < (rx.bit_max_period >> 16))
-		overflow_count++;
+	rxOverflow();
 }
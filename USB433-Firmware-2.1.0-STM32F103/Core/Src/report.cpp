@@ -0,0 +1,152 @@
+/*
+ * report.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#include "string.h"
+#include "stdint.h"
+
+#include "report.h"
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+/*
+ * Check that 'len' more characters fit ahead of the reserve for the line end;
+ * if not, the field is dropped whole and the report marked as overflowed
+ */
+static bool reportFits(Report* report, uint16_t len) {
+	if (report->overflow || report->len + len + REPORT_RESERVE > report->size) {
+		report->overflow = true;
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Copy 'len' characters to the end of the report
+ */
+static void reportPut(Report* report, const char* str, uint16_t len) {
+	memcpy(report->buf + report->len, str, len);
+	report->len += len;
+	report->buf[report->len] = 0;
+}
+
+/*
+ * Start an empty report in 'buf', which holds 'size' bytes
+ */
+void reportBegin(Report* report, char* buf, uint16_t size) {
+	report->buf = buf;
+	report->size = size;
+	report->len = 0;
+	report->overflow = size < REPORT_RESERVE;
+	if (size)
+		buf[0] = 0;
+}
+
+/*
+ * Append a character
+ */
+void reportChar(Report* report, char c) {
+	if (reportFits(report, 1))
+		reportPut(report, &c, 1);
+}
+
+/*
+ * Append a null terminated string
+ */
+void reportStr(Report* report, const char* str) {
+	uint16_t len = strlen(str);
+	if (reportFits(report, len))
+		reportPut(report, str, len);
+}
+
+/*
+ * Append an unsigned value in decimal, zero padded to at least 'width' digits
+ */
+void reportU32Pad(Report* report, uint32_t value, uint8_t width) {
+	// digits are produced least significant first, into the end of the scratch
+	char digits[10];
+	uint8_t idx = sizeof(digits);
+	do {
+		digits[--idx] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	while (idx > 0 && sizeof(digits) - idx < width)
+		digits[--idx] = '0';
+
+	if (reportFits(report, sizeof(digits) - idx))
+		reportPut(report, &digits[idx], sizeof(digits) - idx);
+}
+
+/*
+ * Append an unsigned value in decimal
+ */
+void reportU32(Report* report, uint32_t value) {
+	reportU32Pad(report, value, 1);
+}
+
+/*
+ * Append a signed value in decimal
+ */
+void reportI32(Report* report, int32_t value) {
+	if (value >= 0) {
+		reportU32(report, value);
+		return;
+	}
+	if (!reportFits(report, 2))
+		return;
+	uint16_t start = report->len;
+	reportPut(report, "-", 1);
+	reportU32(report, 0 - (uint32_t) value);
+	if (report->overflow) {
+		// the digits didn't fit; don't leave a lone sign
+		report->len = start;
+		report->buf[start] = 0;
+	}
+}
+
+/*
+ * Append the low 'digits' nibbles of a value in upper case hex, without prefix
+ */
+void reportHex(Report* report, uint32_t value, uint8_t digits) {
+	char hex[8];
+	if (digits > sizeof(hex))
+		digits = sizeof(hex);
+	for (uint8_t i = digits; i > 0; i--) {
+		hex[i - 1] = hex_digits[value & 0xF];
+		value >>= 4;
+	}
+	if (reportFits(report, digits))
+		reportPut(report, hex, digits);
+}
+
+/*
+ * Append " name:value", the field format of the text reports
+ */
+void reportField(Report* report, const char* name, uint32_t value) {
+	uint16_t len = strlen(name);
+	// the name and the shortest value must fit together, or neither is written
+	if (!reportFits(report, len + 2))
+		return;
+	uint16_t start = report->len;
+	reportPut(report, " ", 1);
+	reportPut(report, name, len);
+	reportPut(report, ":", 1);
+	reportU32(report, value);
+	if (report->overflow) {
+		// the value didn't fit; take back its name
+		report->len = start;
+		report->buf[start] = 0;
+	}
+}
+
+/*
+ * End the line with "\r\n". The reserve held back from the fields makes sure
+ * this fits, so a truncated report is still a whole line.
+ */
+void reportEnd(Report* report) {
+	if (report->len + 2 < report->size)
+		reportPut(report, "\r\n", 2);
+}
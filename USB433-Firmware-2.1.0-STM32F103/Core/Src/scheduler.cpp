@@ -0,0 +1,48 @@
+/*
+ * scheduler.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#include "stm32f1xx_hal.h"
+
+#include "stdint.h"
+
+#include "scheduler.h"
+
+/*
+ * Run each ready task once, in priority order (index 0 first). Every run is
+ * timed with the DWT cycle counter against the task budget. Returns true if
+ * any task reported more work, in which case the caller shouldn't sleep.
+ */
+bool runTasks(Task* tasks, uint8_t count, uint32_t events) {
+	bool more_work = false;
+	for (uint8_t i = 0; i < count; i++) {
+		Task* task = &tasks[i];
+		if (!task->ready(events))
+			continue;
+
+		uint32_t start = DWT->CYCCNT;
+		more_work |= task->run();
+		uint32_t elapsed = DWT->CYCCNT - start;
+
+		task->runs++;
+		if (elapsed > task->wcet_cycles)
+			task->wcet_cycles = elapsed;
+		if (elapsed > task->budget_cycles)
+			task->overruns++;
+	}
+	return more_work;
+}
+
+/*
+ * Clear the execution statistics of all tasks
+ */
+void resetTaskStats(Task* tasks, uint8_t count) {
+	for (uint8_t i = 0; i < count; i++) {
+		tasks[i].runs = 0;
+		tasks[i].wcet_cycles = 0;
+		tasks[i].overruns = 0;
+	}
+}
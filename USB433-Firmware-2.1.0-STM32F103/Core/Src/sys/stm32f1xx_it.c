@@ -22,6 +22,8 @@
 #include "stm32f1xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "latency.h"
+#include "isr.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -207,6 +209,10 @@ void SysTick_Handler(void)
 void DMA1_Channel2_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Channel2_IRQn 0 */
+  // dispatched in txDmaIRQ, at register level or through the HAL handler below;
+  //   txDmaIRQ also records the entry latency, which needs the frame's pulse widths
+  txDmaIRQ();
+  return;
 
   /* USER CODE END DMA1_Channel2_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_tim1_ch1);
@@ -235,6 +241,10 @@ void USB_LP_CAN1_RX0_IRQHandler(void)
 void TIM2_IRQHandler(void)
 {
   /* USER CODE BEGIN TIM2_IRQn 0 */
+  // dispatched in rxCaptureIRQ, at register level or through the HAL handler below;
+  //   rxCaptureIRQ also records the entry latency, as reading CCR2 clears its flag
+  rxCaptureIRQ();
+  return;
 
   /* USER CODE END TIM2_IRQn 0 */
   HAL_TIM_IRQHandler(&htim2);
@@ -0,0 +1,95 @@
+/*
+ * timesync.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#include "stm32f1xx_hal.h"
+
+#include "stdint.h"
+
+#include "timesync.h"
+#include "core_main.h"
+
+volatile TimeSync timesync = { 0, 0, 1000 << 16, 0, false };
+
+static uint16_t window_frame = 0; // frame number the rate measurement window started at
+static uint32_t window_us = 0; // local time the rate measurement window started at
+
+/*
+ * Latch the frame number and local time of a start of frame. Called from the
+ * USB interrupt on every SOF (1 ms). Once per window, the local clock is
+ * measured against the host frame clock to correct the mapping for drift.
+ */
+void timesyncSOF(void) {
+	uint32_t now = micros();
+	uint16_t frame = USB->FNR & TIMESYNC_FRAME_MASK;
+
+	if (!timesync.sofs || now - timesync.local_us > TIMESYNC_STALE_US) {
+		// first SOF, or after a suspend; start measuring afresh
+		window_frame = frame;
+		window_us = now;
+	} else {
+		uint16_t frames = (frame - window_frame) & TIMESYNC_FRAME_MASK;
+		if (frames >= TIMESYNC_WINDOW_FRAMES) {
+			uint32_t measured = (uint32_t) (((uint64_t) (now - window_us) << 16) / frames);
+			int32_t error = (int32_t) (measured - (1000 << 16));
+			if (error < TIMESYNC_RATE_TOL_Q16 && error > -TIMESYNC_RATE_TOL_Q16) {
+				if (timesync.calibrated) {
+					int32_t step = (int32_t) (measured - timesync.us_per_frame_q16);
+					timesync.us_per_frame_q16 += step >> TIMESYNC_RATE_SHIFT;
+				} else {
+					timesync.us_per_frame_q16 = measured;
+					timesync.calibrated = true;
+				}
+			}
+			window_frame = frame;
+			window_us = now;
+		}
+	}
+
+	timesync.frame = frame;
+	timesync.local_us = now;
+	timesync.sofs++;
+}
+
+/*
+ * Copy the latest SOF latch, consistent against the SOF interrupt
+ */
+void timesyncLatch(TimeSync* out) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	out->frame = timesync.frame;
+	out->local_us = timesync.local_us;
+	out->us_per_frame_q16 = timesync.us_per_frame_q16;
+	out->sofs = timesync.sofs;
+	out->calibrated = timesync.calibrated;
+	__set_PRIMASK(primask);
+}
+
+/*
+ * Map a local time to the host frame timeline: the 11 bit frame number it
+ * falls in and the host microseconds into that frame. Returns false if there's
+ * no recent SOF to map from (not enumerated, or suspended).
+ */
+bool timesyncMap(uint32_t local_us, uint16_t* frame, uint16_t* frame_us) {
+	TimeSync ref;
+	timesyncLatch(&ref);
+	if (!ref.sofs || micros() - ref.local_us > TIMESYNC_STALE_US)
+		return false;
+
+	// local microseconds from the latest SOF, in host microseconds
+	int32_t delta = (int32_t) (local_us - ref.local_us);
+	int64_t host_us = ((int64_t) delta * (1000 << 16)) / ref.us_per_frame_q16;
+
+	int32_t frames = (int32_t) (host_us / 1000);
+	int32_t rem = (int32_t) (host_us - (int64_t) frames * 1000);
+	if (rem < 0) {
+		frames--;
+		rem += 1000;
+	}
+	*frame = (ref.frame + frames) & TIMESYNC_FRAME_MASK;
+	*frame_us = (uint16_t) rem;
+	return true;
+}
@@ -0,0 +1,83 @@
+/*
+ * trace.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#include "stm32f1xx_hal.h"
+
+#include "string.h"
+#include "stdint.h"
+
+#include "trace.h"
+
+volatile uint32_t trace_mask = (1 << TRACE_EVENT_COUNT) - 1;
+
+static TraceRecord trace_ring[TRACE_RECORDS];
+static volatile uint32_t trace_head = 0; // records ever reserved; the next one goes to trace_head % TRACE_RECORDS
+
+/*
+ * Add a record to the trace ring. Safe to call from any interrupt priority
+ * without masking interrupts: the slot is reserved with LDREX/STREX, so a
+ * handler preempting the write gets the next slot.
+ */
+void traceRecord(TraceEvent event, uint8_t arg8, uint16_t arg16) {
+	if (!(trace_mask & (1 << event)))
+		return;
+
+	uint32_t idx;
+	do {
+		idx = __LDREXW(&trace_head);
+	} while (__STREXW(idx + 1, &trace_head));
+
+	TraceRecord* record = &trace_ring[idx & (TRACE_RECORDS - 1)];
+	record->cycles = DWT->CYCCNT;
+	record->event = event;
+	record->arg8 = arg8;
+	record->arg16 = arg16;
+}
+
+/*
+ * Drop all records
+ */
+void traceClear(void) {
+	trace_head = 0;
+}
+
+/*
+ * Serialize the ring, oldest record first, into a binary dump. Tracing is
+ * paused while copying so records aren't overwritten mid-dump. Returns the
+ * dump length, or 0 if 'size' is too small for it.
+ */
+uint16_t traceDump(uint8_t* buf, uint16_t size) {
+	uint32_t mask = trace_mask;
+	trace_mask = 0;
+
+	uint32_t head = trace_head;
+	uint32_t count = (head < TRACE_RECORDS) ? head : TRACE_RECORDS;
+	if (size < 5 + count * sizeof(TraceRecord) + 1) {
+		trace_mask = mask;
+		return 0;
+	}
+
+	uint16_t len = 0;
+	buf[len++] = TRACE_FRAME_MAGIC0;
+	buf[len++] = TRACE_FRAME_MAGIC1;
+	buf[len++] = TRACE_FRAME_VERSION;
+	buf[len++] = (uint8_t) count;
+	buf[len++] = (uint8_t) (SystemCoreClock / 1000000);
+
+	uint8_t checksum = 0;
+	for (uint32_t i = head - count; i != head; i++) {
+		// the core is little-endian, so the record is copied as laid out
+		memcpy(&buf[len], &trace_ring[i & (TRACE_RECORDS - 1)], sizeof(TraceRecord));
+		for (uint8_t b = 0; b < sizeof(TraceRecord); b++) {
+			checksum ^= buf[len++];
+		}
+	}
+	buf[len++] = checksum;
+
+	trace_mask = mask;
+	return len;
+}
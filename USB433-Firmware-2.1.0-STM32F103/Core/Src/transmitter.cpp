@@ -7,7 +7,6 @@
 
 #include "stm32f1xx_hal.h"
 
-#include "stdio.h"
 #include "string.h"
 #include "limits.h"
 
@@ -15,6 +14,12 @@
 #include "main.h"
 #include "transmitter.h"
 #include "receiver.h"
+#include "events.h"
+#include "perf.h"
+#include "counters.h"
+#include "trace.h"
+#include "isr.h"
+#include "latency.h"
 
 Transmitter tx;
 TxPacket data;
@@ -23,6 +28,9 @@ TxPacket data;
  * Initialize timers and parameters needed for OOK Tx operations
  */
 void txInit(Transmitter* settings) {
+	// tick at the capture timer rate, so learned timings replay without conversion
+	TIM1->PSC = TICK_PRESCALER - 1;
+	TIM1->EGR = TIM_EGR_UG;
 	__HAL_TIM_ENABLE_DMA(&htim1, TIM_DMA_UPDATE);
 
 	// set up ARR register for Transmitter
@@ -31,18 +39,24 @@ void txInit(Transmitter* settings) {
 
 /*
  * Update the Tx timing buffer ARR for signal period, based on configured
- * long and short time values
+ * long and short time values. Returns false, leaving ARR as it was, if the
+ * period doesn't fit the 16 bit count.
  */
-void updateARR(Transmitter* settings) {
+bool updateARR(Transmitter* settings) {
+	uint32_t period = US_TO_TICKS(settings->t_long + settings->t_short);
+	if (period > TX_MAX_PERIOD_TICKS)
+		return false;
+
 	// ARR is 0-based, so correct for that by subtracting 1
-	htim1.Instance->ARR = (uint32_t) (settings->t_long + settings->t_short) - 1;
+	htim1.Instance->ARR = period - 1;
+	return true;
 }
 
 /*
  * Prepare a packet to transmit using the 0 index of settings->buffer
  */
 void makeTxPacket(Transmitter* settings, TxPacket* packet) {
-	if (settings->buffer[0][0] == 0){
+	if (!settings->buffer[0]){
 		status |= (TX_BUFFER_EMPTY << 8);
 		return;
 	} else {
@@ -54,13 +68,38 @@ void makeTxPacket(Transmitter* settings, TxPacket* packet) {
 	packet->frames_sent = 0;
 	memset(packet->dma_buffer, 0, sizeof(packet->dma_buffer));
 
-	for (uint16_t i = 0; i < strlen(settings->buffer[0]); i++) {
-		if (settings->buffer[0][i] == '1') {
-			packet->dma_buffer[packet->dma_len++] =
-				settings->invert_logic ? settings->t_long : settings->t_short;
+	// replayed slots carry their own timing; other words use the current settings
+	bool invert_logic = settings->invert_logic;
+	uint32_t t_short = US_TO_TICKS(settings->t_short);
+	uint32_t t_long = US_TO_TICKS(settings->t_long);
+	packet->frame_delay_us = settings->frame_delay_us;
+	packet->frame_repeat = settings->frame_repeat;
+	if (settings->buffer_slot[0]) {
+		TxSlot* slot = &settings->slots[settings->buffer_slot[0] - 1];
+		invert_logic = slot->invert_logic;
+		t_short = slot->t_short_ticks;
+		t_long = slot->t_long_ticks;
+		packet->frame_delay_us = slot->frame_delay_us;
+		packet->frame_repeat = slot->frame_repeat;
+	}
+	if (t_long + t_short > TX_MAX_PERIOD_TICKS || t_long > UINT16_MAX || t_short > UINT16_MAX) {
+		// the bit period doesn't fit the 16 bit count
+		status |= (TX_PREP_FAILED << 8);
+		return;
+	}
+	htim1.Instance->ARR = t_long + t_short - 1;
+
+	uint16_t len = strlen(settings->buffer[0]);
+	for (uint16_t i = 0; i < len; i++) {
+		if (i > TX_MAX_BITS) {
+			// word plus sync bit doesn't fit the DMA buffer
+			packet->dma_len = 0;
+			status |= (TX_PREP_FAILED << 8);
+			return;
+		} else if (settings->buffer[0][i] == '1') {
+			packet->dma_buffer[packet->dma_len++] = invert_logic ? t_long : t_short;
 		} else if (settings->buffer[0][i] == '0') {
-			packet->dma_buffer[packet->dma_len++] =
-				settings->invert_logic ? settings->t_short : settings->t_long;
+			packet->dma_buffer[packet->dma_len++] = invert_logic ? t_short : t_long;
 		} else {
 			packet->dma_len = 0;
 			memset(packet->dma_buffer, 0, sizeof(packet->dma_buffer));
@@ -78,6 +117,8 @@ void makeTxPacket(Transmitter* settings, TxPacket* packet) {
  * Handle the transmission dispatch process based on frames and burst completion for a packet.
  */
 void processTx(Transmitter* settings, TxPacket* packet) {
+	PERF_SCOPE(PERF_PROCESS_TX);
+
 	uint32_t now;
 	if (packet->burst_complete) {
 		// any prior transmission has completed
@@ -93,13 +134,18 @@ void processTx(Transmitter* settings, TxPacket* packet) {
 
 			// start the burst transmission
 			packet->burst_complete = false;
+			counters.tx_bursts++;
 			status &= (TX_COMPLETE << 8); // set status flag as tx incomplete
 
 			HAL_GPIO_WritePin(TX_ACT_GPIO_Port, TX_ACT_Pin, GPIO_PIN_SET);
 
 			// disable receive radio before transmission starts
+			packet->blind_start_us = 0;
+			packet->blind_us = 0;
 			if (rx.mode == 2 && isRxEnabled()) {
+				rx.blind = true;
 				disableRx();
+				packet->blind_start_us = micros();
 			}
 		} else {
 			// inter-burst timeout hasn't happened, so return;
@@ -115,35 +161,181 @@ void processTx(Transmitter* settings, TxPacket* packet) {
 			packet->last_frame_time_ms = UINT32_MAX - packet->last_frame_time_ms;
 		}
 
-		if (packet->frames_sent > settings->frame_repeat) {
+		if (packet->frames_sent > packet->frame_repeat) {
 			// the number of frames sent equals the desired burst amount
 			packet->burst_complete = true;
 			status |= (TX_COMPLETE << 8); // indicate transmission complete
 
 			HAL_GPIO_WritePin(TX_ACT_GPIO_Port, TX_ACT_Pin, GPIO_PIN_RESET);
 
-			// re-enable the receive radio if rx mode is
-			if (rx.mode == 2 && !isRxEnabled()) {
-				// enable radio if it's currently disabled
-				enableRx();
+			// the receiver is normally re-enabled by the DMA complete interrupt;
+			//   catch a burst that ended without it (e.g. rx mode changed mid-burst)
+			if (rx.blind) {
+				resumeRxAfterTx(packet);
 			}
-		} else if (now < packet->last_frame_time_ms || now - packet->last_frame_time_ms >= (settings->frame_delay_us / (float) 1000)) {
+		} else if (now < packet->last_frame_time_ms || now - packet->last_frame_time_ms >= (packet->frame_delay_us + 999) / 1000) {
 			// an adequate delay has elapsed between frames, trigger the next transmission
+			// (frame_delay_us is rounded up to whole ms ticks; the same as comparing against the fraction)
 			// (tick, even after adjustment for rollover is earlier than last time or delta elapsed)
 
 			// set frame complete false, increment number of frames sent, and trigger transmit
 			packet->frame_complete = false;
 			packet->frames_sent++;
+			counters.tx_frames++;
+			traceRecord(TRACE_TX_START, packet->frames_sent, 0);
 
 			HAL_TIM_PWM_Start_DMA(&htim1, TIM_CHANNEL_1, (uint32_t *) packet->dma_buffer, packet->dma_len);
 		}
 	}
 }
 
-// ==================== HAL ISR Callback ==========================
+/*
+ * Store the timing of a received word into a slot so it can be replayed as-is.
+ * 'repeats' is how many repeated frames were observed; 'sync_bit' prepends the
+ * start bit the receiver dropped from the word. Returns false if a pulse or the
+ * bit period doesn't fit the 16 bit timer or the packet arena can't hold the
+ * word, leaving the slot as it was.
+ */
+bool learnTxSlot(Transmitter* settings, uint8_t index, RxPacket* packet, uint8_t repeats, bool sync_bit) {
+	TxSlot* slot = &settings->slots[index];
+	if (packet->long_ticks > UINT16_MAX || packet->short_ticks > UINT16_MAX
+			|| packet->long_ticks + packet->short_ticks > TX_MAX_PERIOD_TICKS)
+		return false;
+	char* word = arenaAlloc(strlen(packet->word) + 2);
+	if (!word) {
+		counters.arena_failures++;
+		return false;
+	}
+	char* idx = word;
+	if (sync_bit)
+		*idx++ = packet->logic ? '1' : '0';
+	strcpy(idx, packet->word);
+	arenaFree(slot->word);
+	slot->word = word;
+	slot->invert_logic = packet->logic;
+	slot->t_short_ticks = (uint16_t) packet->short_ticks;
+	slot->t_long_ticks = (uint16_t) packet->long_ticks;
+
+	// the last bit of a frame runs into the gap; delay the remainder of the gap
+	slot->frame_delay_us = TICKS_TO_US(packet->period_ticks);
+	if (packet->gap_ticks > 2 * packet->period_ticks)
+		slot->frame_delay_us = TICKS_TO_US(packet->gap_ticks - packet->period_ticks);
+
+	// send at least as many frames as were observed in the received burst
+	slot->frame_repeat = (repeats > settings->frame_repeat + 1) ? repeats - 1 : settings->frame_repeat;
+	slot->valid = true;
+	return true;
+}
+
+/*
+ * Check if a burst is being sent or a word is queued to be sent
+ */
+bool isTxActive(void) {
+	return !data.burst_complete || !data.frame_complete || tx.buffer[0];
+}
+
+/*
+ * Queue a learned slot for replay. Returns false if the slot is empty, or the
+ * transmit buffer or packet arena is full.
+ */
+bool queueTxSlot(Transmitter* settings, uint8_t slot) {
+	if (slot >= TX_SLOTS || !settings->slots[slot].valid)
+		return false;
+
+	for (unsigned int i = 0; i < TX_BUFFER_LEN; i++) {
+		if (!settings->buffer[i]) {
+			char* word = arenaAlloc(strlen(settings->slots[slot].word) + 1);
+			if (!word) {
+				counters.arena_failures++;
+				return false;
+			}
+			strcpy(word, settings->slots[slot].word);
+			settings->buffer[i] = word;
+			settings->buffer_slot[i] = slot + 1;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * End the receiver blind window of a burst: re-enable the radio if the rx mode
+ * calls for it and record how long it was disabled
+ */
+void resumeRxAfterTx(TxPacket* packet) {
+	if (rx.mode == 2 && !isRxEnabled()) {
+		enableRx();
+	}
+	packet->blind_us = micros() - packet->blind_start_us;
+	rx.blind = false;
+}
+
+// ==================== ISR and HAL Callbacks ====================
+
+/*
+ * A frame's PWM has been stopped after its last pulse was loaded
+ */
+static void txFrameDone(void) {
+	traceRecord(TRACE_TX_STOP, data.frames_sent, 0);
+
+	// re-enable the receiver as soon as the last frame of the burst is out
+	//   so replies to it are not lost waiting for the main loop
+	if (data.frames_sent > data.frame_repeat && rx.blind) {
+		resumeRxAfterTx(&data);
+	}
+
+	data.frame_complete = true;
+	data.last_frame_time_ms = HAL_GetTick();
+	postEvent(EVT_TX_FRAME);
+}
+
+/*
+ * TX DMA interrupt. The fast path does at register level what HAL_DMA_IRQHandler,
+ * the TIM PWM DMA callbacks and HAL_TIM_PWM_Stop_DMA do for the half and full
+ * transfer of a frame, and keeps the HAL handle states in step so the next
+ * HAL_TIM_PWM_Start_DMA works. Transfer errors are left to the HAL.
+ */
+void txDmaIRQ(void) {
+	// the transfers are requested by the TIM1 CC1 match (CCDS = 0), and the
+	//   last one by the match on the final pulse width; the count at entry
+	//   runs from that compare, wrapping at ARR if the period ended since
+	if ((DMA1->ISR & DMA_ISR_TCIF2) && (DMA1_Channel2->CCR & DMA_CCR_TCIE) && data.dma_len >= 2) {
+		uint32_t count = TIM1->CNT;
+		uint32_t compare = data.dma_buffer[data.dma_len - 2];
+		latencyRecord(LATENCY_DMA_TX, (count >= compare) ? count - compare : count + TIM1->ARR + 1 - compare);
+	}
+	PERF_SCOPE(PERF_TX_DMA_ISR);
+#ifdef ISR_FAST_PATH
+	uint32_t flags = DMA1->ISR;
+	uint32_t ccr = DMA1_Channel2->CCR;
+	if ((flags & DMA_ISR_HTIF2) && (ccr & DMA_CCR_HTIE)) {
+		// half way through the frame; nothing to do
+		DMA1_Channel2->CCR = ccr & ~DMA_CCR_HTIE;
+		DMA1->IFCR = DMA_IFCR_CHTIF2;
+	} else if ((flags & DMA_ISR_TCIF2) && (ccr & DMA_CCR_TCIE)) {
+		DMA1_Channel2->CCR = ccr & ~(DMA_CCR_TEIE | DMA_CCR_TCIE);
+		DMA1->IFCR = DMA_IFCR_CTCIF2;
+		hdma_tim1_ch1.State = HAL_DMA_STATE_READY;
+		__HAL_UNLOCK(&hdma_tim1_ch1);
+
+		// stop the PWM: no more DMA requests, channel output off, then the timer
+		TIM1->DIER &= ~TIM_DIER_CC1DE;
+		TIM1->CCER &= ~TIM_CCER_CC1E;
+		__HAL_TIM_MOE_DISABLE(&htim1);
+		__HAL_TIM_DISABLE(&htim1);
+		TIM_CHANNEL_STATE_SET(&htim1, TIM_CHANNEL_1, HAL_TIM_CHANNEL_STATE_READY);
+
+		txFrameDone();
+	} else {
+		HAL_DMA_IRQHandler(&hdma_tim1_ch1);
+	}
+#else
+	HAL_DMA_IRQHandler(&hdma_tim1_ch1);
+#endif
+}
 
 /*
- * Interrupt callback to execute when transmit data is complete
+ * Interrupt callback of the HAL dispatch to execute when transmit data is complete
  *  - i.e. last data has been sent to register - so data needs to be n+1, where
  *  	   final data is a null value; null value will be first pulse sent.
  */
@@ -151,8 +343,7 @@ void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef *htim) {
 	if(htim->Instance == TIM1) {
 		if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_1) {
 			HAL_TIM_PWM_Stop_DMA(htim, TIM_CHANNEL_1);
-			data.frame_complete = true;
-			data.last_frame_time_ms = HAL_GetTick();
+			txFrameDone();
 		}
 	}
 }
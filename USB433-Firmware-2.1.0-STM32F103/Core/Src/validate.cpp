@@ -0,0 +1,89 @@
+/*
+ * validate.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#include "stdint.h"
+
+#include "validate.h"
+
+RxValidator validators[RX_VALIDATORS];
+
+const char* const validator_names[VALIDATE_TYPES] = { "off", "crc", "xor", "sum", "lfsr" };
+
+/*
+ * Bit 'index' of a packed word; bit 0 is the first received
+ */
+static inline uint32_t wordBit(const uint32_t* packed, uint8_t index) {
+	return (packed[index >> 5] >> (index & 31)) & 1;
+}
+
+/*
+ * Find the validator for words of length 'len'. Returns 0 if words of that
+ * length aren't checked.
+ */
+RxValidator* findValidator(uint8_t len) {
+	for (uint8_t i = 0; i < RX_VALIDATORS; i++) {
+		if (validators[i].type != VALIDATE_OFF && validators[i].len == len)
+			return &validators[i];
+	}
+	return 0;
+}
+
+/*
+ * Check a packed word of length 'len' against its check field
+ */
+bool validateWord(const RxValidator* validator, const uint32_t* packed, uint8_t len) {
+	uint8_t width = validator->width;
+	if (width == 0 || width > 32 || len <= width)
+		return false;
+	uint32_t mask = (width < 32) ? (1UL << width) - 1 : UINT32_MAX;
+	uint8_t data_len = len - width;
+
+	uint32_t expected = 0;
+	for (uint8_t i = data_len; i < len; i++)
+		expected = (expected << 1) | wordBit(packed, i);
+
+	// the LFSR digest starts empty and walks its key from 'init'
+	uint32_t check = (validator->type == VALIDATE_LFSR) ? 0 : validator->init;
+	uint32_t key = validator->init;
+	uint32_t symbol = 0;
+	uint8_t symbol_bits = 0;
+	for (uint8_t i = 0; i < data_len; i++) {
+		uint32_t bit = wordBit(packed, i);
+		switch (validator->type) {
+		case VALIDATE_CRC: {
+			uint32_t top = (check >> (width - 1)) & 1;
+			check <<= 1;
+			if (top ^ bit)
+				check ^= validator->poly;
+			break;
+		}
+		case VALIDATE_XOR:
+		case VALIDATE_SUM:
+			symbol = (symbol << 1) | bit;
+			if (++symbol_bits == width) {
+				check = (validator->type == VALIDATE_XOR) ? check ^ symbol : check + symbol;
+				symbol = 0;
+				symbol_bits = 0;
+			}
+			break;
+		case VALIDATE_LFSR:
+			if (bit)
+				check ^= key;
+			key = (key & 1) ? (key >> 1) ^ validator->poly : key >> 1;
+			break;
+		default:
+			return false;
+		}
+	}
+
+	// a short last symbol is padded with zeros
+	if (symbol_bits) {
+		symbol <<= width - symbol_bits;
+		check = (validator->type == VALIDATE_XOR) ? check ^ symbol : check + symbol;
+	}
+	return (check & mask) == expected;
+}
@@ -22,7 +22,9 @@
 #include "usbd_cdc_if.h"
 
 /* USER CODE BEGIN INCLUDE */
-
+#include "events.h"
+#include "counters.h"
+#include "trace.h"
 /* USER CODE END INCLUDE */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -97,6 +99,13 @@ uint8_t UserTxBufferFS[APP_TX_DATA_SIZE];
 
 char usb_rx_buffer[USER_USB_BUF_SIZE];
 
+/* UserTxBufferFS is used as a ring of queued IN data: bytes between tail and
+ * head are queued, of which the first 'in_flight' are being transmitted. The
+ * tail moves in CDC_Drain_FS, which also runs from the USB interrupt. */
+static volatile uint16_t tx_head = 0;
+static volatile uint16_t tx_tail = 0;
+static volatile uint16_t tx_in_flight = 0;
+
 /* USER CODE END PRIVATE_VARIABLES */
 
 /**
@@ -268,6 +277,9 @@ static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
   memset(usb_rx_buffer, 0, sizeof(usb_rx_buffer));
   memcpy(usb_rx_buffer, Buf, len);
   memset(Buf, 0, len);
+  counters.usb_bytes_in += len;
+  traceRecord(TRACE_USB_IN, 0, (uint16_t) len);
+  postEvent(EVT_USB_RX);
 
   return (USBD_OK);
   /* USER CODE END 6 */
@@ -300,6 +312,105 @@ uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
+/**
+  * @brief  CDC_Queue_FS
+  *         Copy data to the IN queue, to be sent by CDC_Drain_FS. Data is
+  *         queued whole or not at all.
+  * @param  Buf: Buffer of data to be sent
+  * @param  Len: Number of data to be sent (in bytes)
+  * @retval Number of bytes queued: Len, or 0 if the queue is too full
+  */
+uint16_t CDC_Queue_FS(uint8_t* Buf, uint16_t Len)
+{
+  uint16_t free_space = APP_TX_DATA_SIZE - 1 - CDC_Pending_FS();
+  if (Len == 0) {
+    return 0;
+  }
+  if (Len > free_space) {
+    counters.usb_busy_drops++;
+    return 0;
+  }
+
+  for (uint16_t i = 0; i < Len; i++) {
+    UserTxBufferFS[tx_head] = Buf[i];
+    tx_head = (tx_head + 1) % APP_TX_DATA_SIZE;
+  }
+  counters.usb_bytes_out += Len;
+  return Len;
+}
+
+/**
+  * @brief  CDC_Pending_FS
+  * @retval Number of bytes queued or in flight on the IN endpoint
+  */
+uint16_t CDC_Pending_FS(void)
+{
+  return (tx_head + APP_TX_DATA_SIZE - tx_tail) % APP_TX_DATA_SIZE;
+}
+
+/**
+  * @brief  CDC_Busy_FS
+  * @retval 1 if a transfer is in flight on the IN endpoint, else 0
+  */
+uint8_t CDC_Busy_FS(void)
+{
+  return tx_in_flight != 0;
+}
+
+/**
+  * @brief  CDC_Drain_FS
+  *         Release the last completed transfer from the IN queue and start
+  *         the next one with the longest contiguous run of queued data.
+  *         Called from the main loop to start an idle endpoint, and from
+  *         the IN complete interrupt (CDC_TxComplete_FS) to chain transfers.
+  * @retval USBD_OK if idle or a transfer was started, USBD_BUSY if the
+  *         previous transfer is still in progress, USBD_FAIL if not configured
+  */
+uint8_t CDC_Drain_FS(void)
+{
+  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
+  if (hcdc == NULL) {
+    return USBD_FAIL;
+  }
+  if (hcdc->TxState != 0) {
+    return USBD_BUSY;
+  }
+
+  // previous transfer is complete; free its bytes
+  tx_tail = (tx_tail + tx_in_flight) % APP_TX_DATA_SIZE;
+  tx_in_flight = 0;
+  if (tx_tail == tx_head) {
+    return USBD_OK;
+  }
+
+  uint16_t len = (tx_head > tx_tail) ? tx_head - tx_tail : APP_TX_DATA_SIZE - tx_tail;
+  // mark the bytes in flight first; the transfer may complete and drain
+  //   again from the interrupt before CDC_Transmit_FS returns
+  tx_in_flight = len;
+  uint8_t result = CDC_Transmit_FS(&UserTxBufferFS[tx_tail], len);
+  if (result == USBD_OK) {
+    traceRecord(TRACE_USB_OUT, 0, len);
+  } else {
+    tx_in_flight = 0;
+  }
+  return result;
+}
+
+/**
+  * @brief  CDC_TxComplete_FS
+  *         Called from the USB interrupt (Stream_DataIn) when an IN transfer
+  *         completes. Starts the next queued run right away, so the
+  *         double buffered endpoint keeps streaming without waiting on the
+  *         main loop.
+  * @param  epnum: endpoint number of the completed transfer
+  */
+void CDC_TxComplete_FS(uint8_t epnum)
+{
+  if ((epnum | 0x80U) == CDC_IN_EP) {
+    CDC_Drain_FS();
+  }
+}
+
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
 /**
@@ -112,7 +112,11 @@ extern USBD_CDC_ItfTypeDef USBD_Interface_fops_FS;
 uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
 
 /* USER CODE BEGIN EXPORTED_FUNCTIONS */
-
+uint16_t CDC_Queue_FS(uint8_t* Buf, uint16_t Len);
+uint16_t CDC_Pending_FS(void);
+uint8_t CDC_Busy_FS(void);
+uint8_t CDC_Drain_FS(void);
+void CDC_TxComplete_FS(uint8_t epnum);
 /* USER CODE END EXPORTED_FUNCTIONS */
 
 /**
@@ -0,0 +1,270 @@
+/*
+ * usbd_stream_if.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#include "string.h"
+
+#include "usbd_stream_if.h"
+#include "usbd_cdc_if.h"
+#include "usbd_ctlreq.h"
+#include "counters.h"
+
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+/* The device class wraps USBD_CDC: the CDC interfaces work as before, and the
+ * stream endpoint is opened, closed and completed here */
+static uint8_t Stream_Init(USBD_HandleTypeDef* pdev, uint8_t cfgidx);
+static uint8_t Stream_DeInit(USBD_HandleTypeDef* pdev, uint8_t cfgidx);
+static uint8_t Stream_Setup(USBD_HandleTypeDef* pdev, USBD_SetupReqTypedef* req);
+static uint8_t Stream_EP0_RxReady(USBD_HandleTypeDef* pdev);
+static uint8_t Stream_DataIn(USBD_HandleTypeDef* pdev, uint8_t epnum);
+static uint8_t Stream_DataOut(USBD_HandleTypeDef* pdev, uint8_t epnum);
+static uint8_t* Stream_GetCfgDesc(uint16_t* length);
+static uint8_t* Stream_GetOtherSpeedCfgDesc(uint16_t* length);
+static uint8_t* Stream_GetDeviceQualifierDesc(uint16_t* length);
+
+USBD_ClassTypeDef USBD_CDC_Stream =
+{
+  Stream_Init,
+  Stream_DeInit,
+  Stream_Setup,
+  NULL,
+  Stream_EP0_RxReady,
+  Stream_DataIn,
+  Stream_DataOut,
+  NULL,
+  NULL,
+  NULL,
+  Stream_GetCfgDesc,
+  Stream_GetCfgDesc,
+  Stream_GetOtherSpeedCfgDesc,
+  Stream_GetDeviceQualifierDesc,
+};
+
+__ALIGN_BEGIN static uint8_t stream_cfg_desc[USB_STREAM_CONFIG_DESC_SIZ] __ALIGN_END;
+
+/* Interface association: groups the two CDC interfaces into one function, so
+ * the host binds its serial driver to them and leaves the stream interface */
+static const uint8_t stream_iad_desc[8] =
+{
+  0x08,   /* bLength */
+  0x0B,   /* bDescriptorType: Interface Association */
+  0x00,   /* bFirstInterface */
+  0x02,   /* bInterfaceCount */
+  0x02,   /* bFunctionClass: Communication Interface Class */
+  0x02,   /* bFunctionSubClass: Abstract Control Model */
+  0x01,   /* bFunctionProtocol: Common AT commands */
+  0x00    /* iFunction */
+};
+
+static const uint8_t stream_itf_desc[9 + 7] =
+{
+  /* Stream interface descriptor */
+  0x09,   /* bLength */
+  USB_DESC_TYPE_INTERFACE,
+  STREAM_ITF_NUM,   /* bInterfaceNumber */
+  0x00,   /* bAlternateSetting */
+  0x01,   /* bNumEndpoints */
+  0xFF,   /* bInterfaceClass: vendor specific */
+  0x00,   /* bInterfaceSubClass */
+  0x00,   /* bInterfaceProtocol */
+  0x00,   /* iInterface */
+
+  /* Stream IN endpoint descriptor */
+  0x07,   /* bLength */
+  USB_DESC_TYPE_ENDPOINT,
+  STREAM_IN_EP,   /* bEndpointAddress */
+  0x02,   /* bmAttributes: Bulk */
+  LOBYTE(STREAM_PACKET_SIZE),   /* wMaxPacketSize */
+  HIBYTE(STREAM_PACKET_SIZE),
+  0x00    /* bInterval: ignored for bulk */
+};
+
+/* stream_buffer is a ring of queued IN data: bytes between tail and head are
+ * queued, of which the first 'in_flight' are being transmitted */
+static uint8_t stream_buffer[STREAM_DATA_SIZE];
+static volatile uint16_t stream_head = 0;
+static volatile uint16_t stream_tail = 0;
+static volatile uint16_t stream_in_flight = 0;
+
+/**
+  * @brief  Stream_Init
+  *         Configure the CDC interfaces, then open the stream endpoint with an
+  *         empty queue
+  */
+static uint8_t Stream_Init(USBD_HandleTypeDef* pdev, uint8_t cfgidx)
+{
+  uint8_t ret = USBD_CDC.Init(pdev, cfgidx);
+
+  stream_head = 0;
+  stream_tail = 0;
+  stream_in_flight = 0;
+  USBD_LL_OpenEP(pdev, STREAM_IN_EP, USBD_EP_TYPE_BULK, STREAM_PACKET_SIZE);
+  pdev->ep_in[STREAM_IN_EP & 0xFU].is_used = 1U;
+  return ret;
+}
+
+/**
+  * @brief  Stream_DeInit
+  *         Close the stream endpoint and the CDC interfaces
+  */
+static uint8_t Stream_DeInit(USBD_HandleTypeDef* pdev, uint8_t cfgidx)
+{
+  USBD_LL_CloseEP(pdev, STREAM_IN_EP);
+  pdev->ep_in[STREAM_IN_EP & 0xFU].is_used = 0U;
+  stream_in_flight = 0;
+  return USBD_CDC.DeInit(pdev, cfgidx);
+}
+
+static uint8_t Stream_Setup(USBD_HandleTypeDef* pdev, USBD_SetupReqTypedef* req)
+{
+  return USBD_CDC.Setup(pdev, req);
+}
+
+static uint8_t Stream_EP0_RxReady(USBD_HandleTypeDef* pdev)
+{
+  return USBD_CDC.EP0_RxReady(pdev);
+}
+
+static uint8_t Stream_DataOut(USBD_HandleTypeDef* pdev, uint8_t epnum)
+{
+  return USBD_CDC.DataOut(pdev, epnum);
+}
+
+/**
+  * @brief  Stream_DataIn
+  *         IN transfer complete. On the stream endpoint, free the sent bytes and
+  *         start the next queued run; on the CDC data endpoint, let the CDC
+  *         class finish the transfer and chain the next one.
+  */
+static uint8_t Stream_DataIn(USBD_HandleTypeDef* pdev, uint8_t epnum)
+{
+  if (epnum != (STREAM_IN_EP & 0xFU)) {
+    uint8_t ret = USBD_CDC.DataIn(pdev, epnum);
+    CDC_TxComplete_FS(epnum);
+    return ret;
+  }
+
+  // a transfer of whole packets ends with a zero length packet
+  USBD_EndpointTypeDef* ep = &pdev->ep_in[epnum];
+  if (ep->total_length > 0U && (ep->total_length % STREAM_PACKET_SIZE) == 0U) {
+    ep->total_length = 0U;
+    USBD_LL_Transmit(pdev, STREAM_IN_EP, NULL, 0U);
+    return USBD_OK;
+  }
+
+  stream_tail = (stream_tail + stream_in_flight) % STREAM_DATA_SIZE;
+  stream_in_flight = 0;
+  Stream_Drain_FS();
+  return USBD_OK;
+}
+
+/**
+  * @brief  Stream_GetCfgDesc
+  *         Build the configuration descriptor: the CDC one with an interface
+  *         association in front of its interfaces and the stream interface
+  *         appended
+  */
+static uint8_t* Stream_GetCfgDesc(uint16_t* length)
+{
+  uint16_t cdc_len;
+  uint8_t* cdc = USBD_CDC.GetFSConfigDescriptor(&cdc_len);
+  uint8_t* p = stream_cfg_desc;
+
+  memcpy(p, cdc, 9);
+  p[2] = LOBYTE(USB_STREAM_CONFIG_DESC_SIZ); /* wTotalLength */
+  p[3] = HIBYTE(USB_STREAM_CONFIG_DESC_SIZ);
+  p[4] = STREAM_ITF_NUM + 1U; /* bNumInterfaces */
+  p += 9;
+  memcpy(p, stream_iad_desc, sizeof(stream_iad_desc));
+  p += sizeof(stream_iad_desc);
+  memcpy(p, cdc + 9, cdc_len - 9);
+  p += cdc_len - 9;
+  memcpy(p, stream_itf_desc, sizeof(stream_itf_desc));
+
+  *length = USB_STREAM_CONFIG_DESC_SIZ;
+  return stream_cfg_desc;
+}
+
+static uint8_t* Stream_GetOtherSpeedCfgDesc(uint16_t* length)
+{
+  return USBD_CDC.GetOtherSpeedConfigDescriptor(length);
+}
+
+static uint8_t* Stream_GetDeviceQualifierDesc(uint16_t* length)
+{
+  return USBD_CDC.GetDeviceQualifierDescriptor(length);
+}
+
+/**
+  * @brief  Stream_Queue_FS
+  *         Copy data to the stream IN queue, to be sent by Stream_Drain_FS.
+  *         Data is queued whole or not at all.
+  * @retval Number of bytes queued: Len, or 0 if the queue is too full
+  */
+uint16_t Stream_Queue_FS(uint8_t* Buf, uint16_t Len)
+{
+  uint16_t free_space = STREAM_DATA_SIZE - 1 - Stream_Pending_FS();
+  if (Len == 0) {
+    return 0;
+  }
+  if (Len > free_space) {
+    counters.stream_drops++;
+    return 0;
+  }
+
+  for (uint16_t i = 0; i < Len; i++) {
+    stream_buffer[stream_head] = Buf[i];
+    stream_head = (stream_head + 1) % STREAM_DATA_SIZE;
+  }
+  counters.stream_bytes_out += Len;
+  return Len;
+}
+
+/**
+  * @brief  Stream_Pending_FS
+  * @retval Number of bytes queued or in flight on the stream endpoint
+  */
+uint16_t Stream_Pending_FS(void)
+{
+  return (stream_head + STREAM_DATA_SIZE - stream_tail) % STREAM_DATA_SIZE;
+}
+
+/**
+  * @brief  Stream_Busy_FS
+  * @retval 1 if a transfer is in flight on the stream endpoint, else 0
+  */
+uint8_t Stream_Busy_FS(void)
+{
+  return stream_in_flight != 0;
+}
+
+/**
+  * @brief  Stream_Drain_FS
+  *         Start the next transfer on the stream endpoint with the longest
+  *         contiguous run of queued data. Called from the main loop to start an
+  *         idle endpoint, and from Stream_DataIn to chain transfers.
+  * @retval USBD_OK if idle or a transfer was started, USBD_BUSY if a transfer
+  *         is in progress, USBD_FAIL if not configured
+  */
+uint8_t Stream_Drain_FS(void)
+{
+  if (hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED) {
+    return USBD_FAIL;
+  }
+  if (stream_in_flight != 0) {
+    return USBD_BUSY;
+  }
+  if (stream_tail == stream_head) {
+    return USBD_OK;
+  }
+
+  uint16_t len = (stream_head > stream_tail) ? stream_head - stream_tail : STREAM_DATA_SIZE - stream_tail;
+  // mark the bytes in flight first; the transfer may complete before the call returns
+  stream_in_flight = len;
+  hUsbDeviceFS.ep_in[STREAM_IN_EP & 0xFU].total_length = len;
+  return USBD_LL_Transmit(&hUsbDeviceFS, STREAM_IN_EP, &stream_buffer[stream_tail], len);
+}
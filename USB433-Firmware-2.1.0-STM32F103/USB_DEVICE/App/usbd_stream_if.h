@@ -0,0 +1,38 @@
+/*
+ * usbd_stream_if.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: R
+ */
+
+#ifndef __USBD_STREAM_IF_H__
+#define __USBD_STREAM_IF_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "usbd_cdc.h"
+
+/* The stream interface is a vendor specific interface with one bulk IN
+ * endpoint, added to the CDC configuration. Asynchronous reports can be routed
+ * to it so they don't hold up command responses on the CDC data endpoint. */
+#define STREAM_ITF_NUM 0x02U // interface number, after the two CDC interfaces
+#define STREAM_IN_EP 0x83U
+#define STREAM_PACKET_SIZE 64U
+#define STREAM_DATA_SIZE 512 // IN queue size, in bytes
+
+#define USB_STREAM_CONFIG_DESC_SIZ (USB_CDC_CONFIG_DESC_SIZ + 8U + 9U + 7U) // CDC + IAD + interface + endpoint
+
+extern USBD_ClassTypeDef USBD_CDC_Stream;
+
+uint16_t Stream_Queue_FS(uint8_t* Buf, uint16_t Len);
+uint16_t Stream_Pending_FS(void);
+uint8_t Stream_Busy_FS(void);
+uint8_t Stream_Drain_FS(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_STREAM_IF_H__ */
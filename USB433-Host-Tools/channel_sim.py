@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""
+Synthetic 433 MHz OOK channel: build the pulse train a USB433 receiver would
+capture from one or more transmitters and write it as a decode_bench.py corpus.
+
+    channel_sim.py --tx ev1527:101100111000111100001010 -o outlet.txt
+    channel_sim.py --tx ev1527:1011...@0 --tx pwm:1100...@7.5 --jitter 40 \\
+                   --agc-rate 3000 --spurious 50 --dropout 0.01 -o collision.txt
+
+Transmitters ("--tx <encoder>:<bits>[@<start ms>]") are keyed on the same
+channel, so overlapping bursts merge as the receiver would see them (carrier
+from either one is a high level). Impairments:
+    --jitter     gaussian timing jitter of every edge, in us (standard deviation)
+    --spurious   glitches per second: short notches in carrier or short pulses in idle
+    --dropout    probability a transmitted pulse is lost
+    --agc-rate   noise edges per second while no carrier is present (receivers like
+                 the SRX882 raise their gain with no carrier and output random edges);
+                 noise starts once the carrier has been gone for --agc-open us
+
+The samples are cut into chunks where the receiver's word timeout would fire
+(--bitperiod, as set with "rx bitperiod"). The expected words are the transmitted
+bits with the decoder's default logic (short high pulse = '1').
+"""
+
+import argparse
+import random
+
+ENCODERS = {
+    # name: (bit period us, short high us, long high us, frame gap us, sync high us)
+    "ev1527": (1400, 350, 1050, 10850, 350),  # outlet remotes: sync high 1 unit, low 31 units
+    "pwm": (2000, 500, 1500, 9000, 0),  # weather stations: no sync pulse, gap between frames
+}
+
+
+def frames(encoder, bits, start_us, count):
+    """High intervals (start, end) of 'count' frames of 'bits', in us."""
+    period, short, long_, gap, sync = ENCODERS[encoder]
+    t = start_us
+    pulses = []
+    for _ in range(count):
+        for b in bits:
+            width = short if b == "1" else long_
+            pulses.append((t, t + width))
+            t += period
+        if sync:
+            pulses.append((t, t + sync))
+            t += sync
+        t += gap
+    return pulses
+
+
+def merge(pulses):
+    """Union of overlapping high intervals."""
+    out = []
+    for start, end in sorted(pulses):
+        if out and start <= out[-1][1]:
+            out[-1] = (out[-1][0], max(out[-1][1], end))
+        else:
+            out.append((start, end))
+    return out
+
+
+def impair(pulses, rng, args, end_us):
+    pulses = [p for p in pulses if rng.random() >= args.dropout]
+
+    # AGC noise in the idle stretches, once the gain has had time to open
+    noise = []
+    idle_start = 0.0
+    for start, end in pulses + [(end_us, end_us)]:
+        t = idle_start + args.agc_open
+        while args.agc_rate > 0:
+            t += rng.expovariate(args.agc_rate / 2e6)  # two edges per noise pulse
+            width = rng.uniform(20, 400)
+            if t + width >= start:
+                break
+            noise.append((t, t + width))
+            t += width
+        idle_start = end
+    pulses = merge(pulses + noise)
+
+    # glitches: a short pulse where there's no carrier, or a notch in a carrier pulse
+    glitches = int(args.spurious * end_us / 1e6)
+    for _ in range(glitches):
+        t = rng.uniform(0, end_us)
+        width = rng.uniform(5, 60)
+        inside = [i for i, (s, e) in enumerate(pulses) if s < t and t + width < e]
+        if inside:
+            s, e = pulses[inside[0]]
+            pulses[inside[0]:inside[0] + 1] = [(s, t), (t + width, e)]
+        else:
+            pulses = merge(pulses + [(t, t + width)])
+
+    if args.jitter:
+        jittered = []
+        for s, e in pulses:
+            s += rng.gauss(0, args.jitter)
+            e += rng.gauss(0, args.jitter)
+            if e > s + 1 and (not jittered or s > jittered[-1][1] + 1):
+                jittered.append((s, e))
+        pulses = jittered
+    return pulses
+
+
+def samples(pulses, bitperiod):
+    """Receiver samples as chunks of (period, width), split at word timeouts."""
+    chunks, chunk = [], []
+    for (s, e), (next_s, _) in zip(pulses, pulses[1:] + [(float("inf"), 0)]):
+        period = next_s - s
+        width = int(round(e - s))
+        if period >= bitperiod:
+            # the receiver times the word out at (about) the bit period
+            chunk.append((bitperiod, width))
+            chunks.append(chunk)
+            chunk = []
+        else:
+            chunk.append((int(round(period)), width))
+    if chunk:
+        chunks.append(chunk)
+    return chunks
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--tx", action="append", required=True,
+                        help="transmitter as <%s>:<bits>[@<start ms>]" % "|".join(ENCODERS))
+    parser.add_argument("--frames", type=int, default=6, help="frames sent by each transmitter")
+    parser.add_argument("--jitter", type=float, default=0, help="edge jitter, us")
+    parser.add_argument("--spurious", type=float, default=0, help="glitches per second")
+    parser.add_argument("--dropout", type=float, default=0, help="probability of losing a pulse")
+    parser.add_argument("--agc-rate", type=float, default=0, help="noise edges per second without carrier")
+    parser.add_argument("--agc-open", type=float, default=20000, help="us without carrier before noise starts")
+    parser.add_argument("--bitperiod", type=int, default=5000, help="receiver word timeout, us")
+    parser.add_argument("--seed", type=int, default=1, help="random seed, for repeatable corpora")
+    parser.add_argument("-o", "--output", required=True, help="corpus file to write")
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    pulses, expect = [], []
+    for tx in args.tx:
+        spec, _, start = tx.partition("@")
+        encoder, _, bits = spec.partition(":")
+        if encoder not in ENCODERS or not bits or set(bits) - set("01"):
+            parser.error("bad transmitter %r" % tx)
+        pulses += frames(encoder, bits, float(start or 0) * 1000, args.frames)
+        expect.append(bits)
+
+    pulses = merge(pulses)
+    end_us = pulses[-1][1] + args.bitperiod * 4
+    pulses = impair(pulses, rng, args, end_us)
+    chunks = samples(pulses, args.bitperiod)
+
+    with open(args.output, "w") as f:
+        f.write("# name: synthetic %s jitter:%g spurious:%g dropout:%g agc:%g seed:%d\n" % (
+            " + ".join(args.tx), args.jitter, args.spurious, args.dropout, args.agc_rate, args.seed))
+        for bits in expect:
+            f.write("# expect: %s\n" % bits)
+        f.write("# config: rx ignoresyncbit 0\n")
+        f.write("# config: rx bitperiod %d\n" % args.bitperiod)
+        for chunk in chunks:
+            f.write(" ".join("%d,%d" % s for s in chunk) + "\n")
+    edges = 2 * sum(len(c) for c in chunks)
+    print("%s: %d chunks, %d edges over %.1f ms (%.0f edges/s)" % (
+        args.output, len(chunks), edges, end_us / 1000, edges / (end_us / 1e6)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,238 @@
+#!/usr/bin/env python3
+"""
+Replay a corpus of captured RF samples through a USB433 dongle's decoder and
+score the words it reports.
+
+    decode_bench.py --port /dev/ttyACM0 corpus/*.txt   # score corpus files
+    decode_bench.py --port /dev/ttyACM0 --record out.txt --seconds 30
+
+Samples are injected with "rx inject" (the radio is switched off with "rx mode 0"
+for the run), so the same checkRxBuffers()/receivedWord() code that decodes live
+captures is measured. Recording uses "rx raw 1" to log live captures.
+
+Corpus file format (text):
+    # name: <description>
+    # expect: <0/1 word>           one line per word that should be reported
+    # match: contains | exact      compare reported words to expected ones (default contains,
+    #                              since the decoder may keep a sync bit at either end)
+    # config: <command>            sent before the file is replayed, e.g. "rx word minlength 24"
+    <period>,<width> <period>,<width> ...
+Each sample line is one chunk of samples as the receiver hands them to the
+decoder, ending with the sample that timed out the word (period >= rx bitperiod).
+Times are in microseconds.
+
+Reported per file and in total: words expected / found (accuracy), false
+positives (reported words that match no expected word), latency as the samples
+injected before each word was first reported, and decoder CPU cycles per word
+from the "perf" command (debug firmware builds only).
+"""
+
+import argparse
+import re
+import sys
+import time
+
+WORD = re.compile(r"^\d+ word:([01]+) len:")
+PERF = re.compile(r"^0 (\w+) n:(\d+) min:\d+ max:\d+ mean:(\d+)")
+MAX_CHUNK = 319  # RX_BUFFER_SAMPLES - 1
+MAX_COMMAND = 62  # a command must arrive in one 64 byte USB packet, with its line end
+
+
+class Dongle:
+    def __init__(self, port):
+        import serial  # pyserial
+
+        self.serial = serial.Serial(port, timeout=0.05)
+        self.pending = b""
+
+    def lines(self, wait=0.05):
+        """Return the reply lines that arrive within 'wait' seconds."""
+        end = time.time() + wait
+        out = []
+        while time.time() < end:
+            self.pending += self.serial.read(4096)
+            while b"\n" in self.pending:
+                line, self.pending = self.pending.split(b"\n", 1)
+                out.append(line.decode(errors="replace").strip())
+        return out
+
+    def command(self, text, wait=0.05):
+        self.serial.write(text.encode() + b"\r\n")
+        return self.lines(wait)
+
+
+def load(path):
+    corpus = {"name": path, "expect": [], "match": "contains", "config": [], "chunks": []}
+    with open(path) as f:
+        for raw in f:
+            line = raw.strip()
+            if not line:
+                continue
+            if line.startswith("#"):
+                key, _, value = line[1:].partition(":")
+                key, value = key.strip(), value.strip()
+                if key == "expect":
+                    corpus["expect"].append(value)
+                elif key == "config":
+                    corpus["config"].append(value)
+                elif key in ("name", "match"):
+                    corpus[key] = value
+                continue
+            chunk = [tuple(int(v) for v in pair.split(",")) for pair in line.split()]
+            if len(chunk) > MAX_CHUNK:
+                raise ValueError("%s: chunk of %d samples is longer than the capture buffer" % (path, len(chunk)))
+            corpus["chunks"].append(chunk)
+    return corpus
+
+
+def matches(reported, expected, mode):
+    return reported == expected if mode == "exact" else expected in reported
+
+
+def inject(dongle, chunk):
+    """Inject one chunk, continued over as many commands as its length needs,
+    and return the reply lines."""
+    pieces, piece = [], ""
+    for s in chunk:
+        pair = "%d,%d," % s
+        if len(piece) + len(pair) > MAX_COMMAND - len("rx inject "):
+            pieces.append(piece)
+            piece = ""
+        piece += pair
+    pieces.append(piece[:-1])  # no trailing comma ends the chunk
+
+    replies = []
+    for piece in pieces:
+        while True:
+            out = dongle.command("rx inject " + piece)
+            if "1" not in out:  # USB_CC_BUSY
+                break
+            time.sleep(0.01)  # decoder still busy with the previous chunk
+        for line in out:
+            if line.startswith("32 "):  # USB_CC_BAD_VALUE
+                raise ValueError("dongle rejected samples: " + line)
+        replies += out
+    return replies
+
+
+def perf(dongle):
+    cycles = {}
+    for line in dongle.command("perf", 0.2):
+        m = PERF.match(line)
+        if m:
+            cycles[m.group(1)] = (int(m.group(2)), int(m.group(3)))
+    return cycles
+
+
+def bench(dongle, corpus):
+    dongle.command("rx mode 0")
+    for cmd in corpus["config"]:
+        dongle.command(cmd)
+    dongle.command("perf reset")
+    dongle.lines(0.2)  # flush
+
+    reported = []  # (word, samples injected when reported)
+    samples = 0
+    for chunk in corpus["chunks"]:
+        out = inject(dongle, chunk)
+        samples += len(chunk)
+        out += dongle.lines(0.02)
+        for line in out:
+            m = WORD.match(line)
+            if m:
+                reported.append((m.group(1), samples))
+    for line in dongle.lines(0.3):
+        m = WORD.match(line)
+        if m:
+            reported.append((m.group(1), samples))
+
+    found, latency = 0, []
+    for expected in corpus["expect"]:
+        hits = [n for w, n in reported if matches(w, expected, corpus["match"])]
+        if hits:
+            found += 1
+            latency.append(hits[0])
+    false_pos = sum(1 for w, _ in reported
+                    if not any(matches(w, e, corpus["match"]) for e in corpus["expect"]))
+
+    cycles = perf(dongle)
+    words = cycles.get("rxword", (0, 0))[0]
+    per_word = (cycles["checkrx"][0] * cycles["checkrx"][1] // words) if words and "checkrx" in cycles else None
+
+    return {
+        "expected": len(corpus["expect"]),
+        "found": found,
+        "false_pos": false_pos,
+        "latency": latency,
+        "cycles_per_word": per_word,
+        "samples": samples,
+    }
+
+
+def record(dongle, path, seconds):
+    """Log live captures to a corpus file, one timed-out chunk per line."""
+    bitperiod = 5000
+    for line in dongle.command("rx bitperiod", 0.2):
+        m = re.match(r"^0 rx bitperiod (\d+)", line)
+        if m:
+            bitperiod = int(m.group(1))
+
+    dongle.command("rx mode 1")
+    dongle.command("rx raw 1")
+    chunk, chunks = [], []
+    end = time.time() + seconds
+    while time.time() < end:
+        for line in dongle.lines(0.1):
+            if not line.startswith("0 raw:"):
+                continue
+            for pair in line[len("0 raw:"):].split():
+                period, width = (int(v) for v in pair.split(","))
+                chunk.append((period, width))
+                if period >= bitperiod or len(chunk) >= MAX_CHUNK:
+                    chunks.append(chunk)
+                    chunk = []
+    dongle.command("rx raw 0")
+    if chunk:
+        chunks.append(chunk)
+
+    with open(path, "w") as f:
+        f.write("# name: recorded %s\n" % time.strftime("%Y-%m-%d %H:%M:%S"))
+        f.write("# expect: \n")
+        for c in chunks:
+            f.write(" ".join("%d,%d" % s for s in c) + "\n")
+    print("recorded %d chunks to %s; fill in the expected words" % (len(chunks), path))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("corpus", nargs="*", help="corpus files to replay")
+    parser.add_argument("--port", required=True, help="serial port of the dongle")
+    parser.add_argument("--record", help="record live captures to this corpus file instead")
+    parser.add_argument("--seconds", type=float, default=10, help="how long to record")
+    args = parser.parse_args()
+
+    dongle = Dongle(args.port)
+    if args.record:
+        record(dongle, args.record, args.seconds)
+        return
+
+    totals = {"expected": 0, "found": 0, "false_pos": 0, "latency": []}
+    for path in args.corpus:
+        r = bench(dongle, load(path))
+        for k in ("expected", "found", "false_pos"):
+            totals[k] += r[k]
+        totals["latency"] += r["latency"]
+        print("%-40s found %d/%d  false+ %d  latency %s  cycles/word %s" % (
+            path, r["found"], r["expected"], r["false_pos"],
+            "/".join(str(n) for n in r["latency"]) or "-",
+            r["cycles_per_word"] if r["cycles_per_word"] is not None else "n/a"))
+
+    if totals["expected"]:
+        mean_latency = sum(totals["latency"]) / len(totals["latency"]) if totals["latency"] else 0
+        print("total: accuracy %.1f%% (%d/%d)  false+ %d  mean latency %.0f samples" % (
+            100.0 * totals["found"] / totals["expected"], totals["found"], totals["expected"],
+            totals["false_pos"], mean_latency))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""
+Merge the received words of several USB433 dongles into one timeline, ordered
+by their USB start of frame timestamps.
+
+    sof_merge.py /dev/ttyACM0 /dev/ttyACM1 --seconds 60
+
+Every word report ends with "local_us:<us> sof:<frame>.<us>": the instant of
+the word's first rising edge on the host's USB frame timeline. Dongles on one
+host see the same frames, so words from different dongles can be ordered to
+within the SOF latch jitter (about 10 us). The 11 bit frame number wraps every
+2048 ms; it is unwrapped against the host arrival time of each report, which
+is good as long as reports arrive within a second of the word.
+
+Words are printed once they are older than --hold seconds, so late reports of
+one dongle still sort in front of earlier reports of another.
+"""
+
+import argparse
+import re
+import sys
+import time
+
+WORD = re.compile(r"^\d+ word:([01]+) len:.* local_us:(\d+) sof:(\d+)\.(\d+)")
+FRAMES = 2048
+
+
+class Unwrapper:
+    """Extend 11 bit frame numbers to a running count, using arrival times."""
+
+    def __init__(self):
+        self.ref = None  # (frame count, host time) of the first word
+
+    def unwrap(self, frame, arrival):
+        if self.ref is None:
+            self.ref = (frame, arrival)
+            return frame
+        expected = self.ref[0] + (arrival - self.ref[1]) * 1000.0
+        turns = round((expected - frame) / FRAMES)
+        return frame + turns * FRAMES
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("ports", nargs="+", help="serial ports of the dongles")
+    parser.add_argument("--seconds", type=float, default=0, help="stop after this long (default: run until ^C)")
+    parser.add_argument("--hold", type=float, default=1.0, help="seconds to hold words for reordering")
+    args = parser.parse_args()
+
+    import serial  # pyserial
+
+    links = [(port, serial.Serial(port, timeout=0)) for port in args.ports]
+    pending = {port: b"" for port in args.ports}
+    unwrapper = Unwrapper()
+    held = []  # (host us, arrival, port, word)
+    end = time.time() + args.seconds if args.seconds else None
+
+    try:
+        while end is None or time.time() < end:
+            now = time.time()
+            for port, link in links:
+                pending[port] += link.read(4096)
+                while b"\n" in pending[port]:
+                    line, pending[port] = pending[port].split(b"\n", 1)
+                    match = WORD.match(line.decode(errors="replace").strip())
+                    if not match:
+                        continue
+                    frame = unwrapper.unwrap(int(match.group(3)), now)
+                    host_us = frame * 1000 + int(match.group(4))
+                    held.append((host_us, now, port, match.group(1)))
+
+            held.sort()
+            while held and now - min(h[1] for h in held) > args.hold:
+                host_us, _, port, word = held.pop(0)
+                print("%14.3f ms  %-14s %s" % (host_us / 1000.0, port, word))
+            time.sleep(0.01)
+    except KeyboardInterrupt:
+        pass
+
+    for host_us, _, port, word in sorted(held):
+        print("%14.3f ms  %-14s %s" % (host_us / 1000.0, port, word))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""
+Render a USB433 trace dump (the reply to the "trace dump" command) as a timeline.
+
+    trace_decode.py dump.bin             # decode a dump saved from a serial terminal
+    trace_decode.py --port /dev/ttyACM0  # request a dump from the dongle (needs pyserial)
+
+The dump format is described in the firmware command dictionary (commands.cpp)
+and Core/Inc/trace.h.
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"\xa5\x54"
+VERSION = 1
+RECORD = struct.Struct("<IBBH")
+
+EVENTS = [
+    "edge",
+    "gap",
+    "word",
+    "tx_start",
+    "tx_stop",
+    "usb_in",
+    "usb_out",
+]
+
+
+def describe(event, arg8, arg16):
+    if event == 0:
+        return "%s %u" % ("period" if arg8 == 1 else "width", arg16)
+    if event == 1:
+        return "gap_us %u%s" % (arg16, "+" if arg16 == 0xFFFF else "")
+    if event == 2:
+        return "len %u%s" % (arg8, " correlated" if arg16 else "")
+    if event in (3, 4):
+        return "frame %u" % arg8
+    if event in (5, 6):
+        return "bytes %u" % arg16
+    return "arg8 %u arg16 %u" % (arg8, arg16)
+
+
+def parse(data):
+    """Return (cycles per us, [(cycles, event, arg8, arg16)]) of the first dump in data."""
+    start = data.find(MAGIC)
+    if start < 0 or len(data) < start + 5:
+        raise ValueError("no trace dump found")
+    version, count, cycles_per_us = data[start + 2], data[start + 3], data[start + 4]
+    if version != VERSION:
+        raise ValueError("unsupported dump version %u" % version)
+
+    body = data[start + 5:start + 5 + count * RECORD.size]
+    if len(body) != count * RECORD.size or len(data) < start + 6 + len(body):
+        raise ValueError("truncated dump")
+    checksum = 0
+    for b in body:
+        checksum ^= b
+    if checksum != data[start + 5 + len(body)]:
+        raise ValueError("checksum mismatch")
+
+    return cycles_per_us, [RECORD.unpack_from(body, i * RECORD.size) for i in range(count)]
+
+
+def render(cycles_per_us, records, out=sys.stdout):
+    if not records:
+        out.write("trace is empty\n")
+        return
+    first = prev = records[0][0]
+    for cycles, event, arg8, arg16 in records:
+        # the cycle counter is 32 bits and wraps every ~60 s at 72 MHz
+        t = ((cycles - first) & 0xFFFFFFFF) / cycles_per_us
+        dt = ((cycles - prev) & 0xFFFFFFFF) / cycles_per_us
+        name = EVENTS[event] if event < len(EVENTS) else "event%u" % event
+        out.write("%12.1f us  +%10.1f  %-8s %s\n" % (t, dt, name, describe(event, arg8, arg16)))
+        prev = cycles
+
+
+def read_port(port):
+    import serial  # pyserial
+
+    with serial.Serial(port, timeout=1) as s:
+        s.reset_input_buffer()
+        s.write(b"trace dump\r\n")
+        data = b""
+        while True:
+            chunk = s.read(1024)
+            if not chunk:
+                return data
+            data += chunk
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("dump", nargs="?", help="file holding a raw trace dump")
+    parser.add_argument("--port", help="serial port of the dongle to request a dump from")
+    args = parser.parse_args()
+
+    if args.port:
+        data = read_port(args.port)
+    elif args.dump:
+        with open(args.dump, "rb") as f:
+            data = f.read()
+    else:
+        parser.error("give a dump file or --port")
+
+    try:
+        cycles_per_us, records = parse(data)
+    except ValueError as e:
+        sys.exit("trace_decode: %s" % e)
+    render(cycles_per_us, records)
+
+
+if __name__ == "__main__":
+    main()
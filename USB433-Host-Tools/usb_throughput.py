@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+"""
+Measure USB IN throughput of a USB433 dongle with its "usb test" stream.
+
+    usb_throughput.py --port /dev/ttyACM0                 # 1 MiB from the dongle
+    usb_throughput.py --port /dev/ttyACM0 --bytes 4194304 --runs 3
+    usb_throughput.py --port /dev/ttyACM0 --stream        # read the stream interface
+    usb_throughput.py --standin                           # local device stand-in
+
+"usb test <n>" replies "0 <n>" and then streams n bytes, where byte i is
+(i % 251). The rate is timed from the first to the last byte of the stream and
+compared to the full-speed bulk ceiling of 19 packets of 64 bytes per 1 ms
+frame. Every byte is checked against the pattern, so dropped or reordered
+packets show up as errors.
+
+--stream routes the test with "usb stream 1" and reads it from the vendor
+bulk stream interface (endpoint 0x83) with pyusb, while commands stay on the
+serial port.
+
+--standin runs a device stand-in on a local pseudo-terminal instead of opening
+a dongle. It answers "usb test" like the firmware, sending --standin-packets
+64 byte packets per 1 ms frame (19 for a double buffered endpoint that is kept
+full; about 1 for a single buffered one restarted from the main loop), so the
+measurement and checks of this script can be tried without hardware.
+"""
+
+import argparse
+import os
+import sys
+import threading
+import time
+
+CEILING = 19 * 64 * 1000  # full-speed bulk bytes per second
+PATTERN = bytes(i % 251 for i in range(251 * 64))
+
+
+def pattern(offset, length):
+    """Return 'length' bytes of the test stream, starting at byte 'offset'."""
+    out = bytearray()
+    while len(out) < length:
+        start = (offset + len(out)) % 251
+        out += PATTERN[start:start + length - len(out)]
+    return bytes(out)
+
+
+class Link:
+    """Serial link to the dongle, or a raw file descriptor for the stand-in."""
+
+    def __init__(self, port=None, fd=None):
+        self.serial = None
+        self.fd = fd
+        if port:
+            import serial  # pyserial
+
+            self.serial = serial.Serial(port, timeout=0.05)
+        self.pending = b""
+
+    def read(self):
+        if self.serial:
+            return self.serial.read(65536)
+        import select
+
+        if select.select([self.fd], [], [], 0.05)[0]:
+            return os.read(self.fd, 65536)
+        return b""
+
+    def write(self, data):
+        if self.serial:
+            self.serial.write(data)
+        else:
+            os.write(self.fd, data)
+
+    def line(self, timeout=1.0):
+        end = time.time() + timeout
+        while b"\n" not in self.pending:
+            if time.time() > end:
+                return None
+            self.pending += self.read()
+        line, self.pending = self.pending.split(b"\n", 1)
+        return line.decode(errors="replace").strip()
+
+    def drain(self):
+        """Drop anything already sent by the device."""
+        while self.read():
+            pass
+        self.pending = b""
+
+
+class StreamLink:
+    """Reader of the vendor bulk stream interface (interface 2, endpoint 0x83)."""
+
+    VID, PID = 0x0483, 0x5740
+    INTERFACE, ENDPOINT = 2, 0x83
+
+    def __init__(self):
+        import usb.core  # pyusb
+        import usb.util
+
+        self.device = usb.core.find(idVendor=self.VID, idProduct=self.PID)
+        if self.device is None:
+            raise RuntimeError("no USB433 dongle found for the stream interface")
+        usb.util.claim_interface(self.device, self.INTERFACE)
+        self.pending = b""
+
+    def read(self):
+        import usb.core
+
+        try:
+            return bytes(self.device.read(self.ENDPOINT, 4096, timeout=50))
+        except usb.core.USBTimeoutError:
+            return b""
+
+    def drain(self):
+        while self.read():
+            pass
+        self.pending = b""
+
+
+class Standin(threading.Thread):
+    """Device stand-in: answers "usb test <n>" on the master side of a pty."""
+
+    def __init__(self, packets_per_frame):
+        super().__init__(daemon=True)
+        import tty
+
+        self.master, self.slave = os.openpty()
+        tty.setraw(self.master)
+        tty.setraw(self.slave)
+        self.frame_bytes = packets_per_frame * 64
+
+    def run(self):
+        buf = b""
+        while True:
+            buf += os.read(self.master, 64)
+            while b"\n" in buf:
+                line, buf = buf.split(b"\n", 1)
+                words = line.decode().split()
+                if words[:2] == ["usb", "test"] and len(words) == 3:
+                    self.stream(int(words[2]))
+                else:
+                    os.write(self.master, b"16\r\n")
+
+    def stream(self, length):
+        os.write(self.master, b"0 %d\r\n" % length)
+        sent = 0
+        frame = time.perf_counter()
+        while sent < length:
+            chunk = pattern(sent, min(self.frame_bytes, length - sent))
+            os.write(self.master, chunk)
+            sent += len(chunk)
+            frame += 0.001
+            delay = frame - time.perf_counter()
+            if delay > 0:
+                time.sleep(delay)
+
+
+def run(link, length, source=None):
+    """Stream 'length' bytes and return (bytes/s, pattern errors). The stream
+    is read from 'source' if given, else from the command link."""
+    source = source or link
+    link.drain()
+    source.drain()
+    link.write(b"usb test %d\r\n" % length)
+    reply = link.line()
+    if reply != "0 %d" % length:
+        raise RuntimeError("unexpected reply to usb test: %r" % reply)
+
+    data = bytearray(source.pending)
+    source.pending = b""
+    start = time.perf_counter() if data else None
+    last = time.perf_counter()
+    while len(data) < length:
+        chunk = source.read()
+        if chunk:
+            if start is None:
+                start = time.perf_counter()
+            data += chunk
+            last = time.perf_counter()
+        elif time.perf_counter() - last > 1.0:
+            break
+    end = last
+
+    got = bytes(data[:length])
+    errors = sum(1 for a, b in zip(got, pattern(0, len(got))) if a != b) + (length - len(got))
+    elapsed = (end - start) if start is not None else 0
+    rate = len(got) / elapsed if elapsed > 0 else 0
+    return rate, errors
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port", help="serial port of the dongle")
+    source.add_argument("--standin", action="store_true", help="test against a local device stand-in")
+    parser.add_argument("--stream", action="store_true",
+                        help="read the test from the stream interface (needs --port and pyusb)")
+    parser.add_argument("--bytes", type=int, default=1 << 20, help="bytes per run (default 1 MiB)")
+    parser.add_argument("--runs", type=int, default=1, help="number of runs")
+    parser.add_argument("--standin-packets", type=int, default=19,
+                        help="64 byte packets the stand-in sends per 1 ms frame (default 19)")
+    args = parser.parse_args()
+
+    if args.standin:
+        standin = Standin(args.standin_packets)
+        standin.start()
+        link = Link(fd=standin.slave)
+    else:
+        link = Link(port=args.port)
+
+    source = None
+    if args.stream:
+        if args.standin:
+            parser.error("--stream needs a dongle")
+        source = StreamLink()
+        link.write(b"usb stream 1\r\n")
+        link.line()
+
+    failed = False
+    for i in range(args.runs):
+        rate, errors = run(link, args.bytes, source)
+        print("run %d: %d bytes  %.0f B/s  %.1f%% of full-speed bulk  errors:%d"
+              % (i + 1, args.bytes, rate, 100.0 * rate / CEILING, errors))
+        failed |= errors != 0
+
+    if args.stream:
+        link.write(b"usb stream 0\r\n")
+        link.line()
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())